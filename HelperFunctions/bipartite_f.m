@@ -1,4 +1,4 @@
-function [B,twom]=bipartite_f(A,gamma)
+function [B,twom,D]=bipartite_f(A,gamma)
 % BIPARTITE_F returns monolayer Barber modularity matrix for undirected bipartite networks, function handle version
 %
 % Version: 2.2.0
@@ -12,6 +12,11 @@ function [B,twom]=bipartite_f(A,gamma)
 %            of "Barber, M. Modularity and community detection in bipartite networks.
 %            Phys. Rev. E 76, 066102 (2007)".
 %         twom: normalisation constant
+%         D: struct describing the same modularity matrix by the
+%            (M+N)x(M+N) adjacency matrix [0 A;A' 0] and the degrees of both
+%            node classes (zero for nodes of the other class), which
+%            GENLOUVAIN optimises natively without forming any columns (use
+%            [S,Q]=genlouvain(D))
 %
 % Usage: [B,twom]=bipartite(A,gamma);
 %        [S,Q]=genlouvain(B);
@@ -66,4 +71,12 @@ else
     B=@modf;
 end
 
+if nargout>2
+    if mm>0
+        w=gamma/mm;
+    else
+        w=0;
+    end
+    D=struct('A',[sparse(m,m),sparse(A);sparse(A)',sparse(n,n)],'krow',[k;zeros(n,1)],'kcol',[zeros(m,1);d'],'layer',ones(N,1),'weight',w);
+end
 end
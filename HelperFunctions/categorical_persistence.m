@@ -27,18 +27,24 @@ function pers=categorical_persistence(S)
 %     Multilayer Networks, with an Application to Correlation Networks",
 %     MMS: A SIAM Interdisciplinary Journal 14, 1-41 (2016). 
 
+if exist('multilayer_handler','file')==3
+    % native version (counts label agreements for each node directly)
+    pers=multilayer_handler('persistence_categorical',S);
+    return
+end
+
 if ~iscell(S)
     S={S};
 end
 
 [N,T]=size(S{1});
-all2all = N*[(-T+1):-1,1:(T-1)];
-A=spdiags(ones(N*T,2*T-2),all2all,N*T,N*T);
 pers=zeros(length(S),1);
 for i=1:length(S)
-
-    G=sparse(1:length(S{i}(:)),S{i}(:),1);
-    pers(i)=trace(G'*A*G)/(N*T*(T-1));
+    % label histogram for each node (sum of h.*(h-1) counts agreeing pairs
+    % of layers)
+    [~,~,e]=unique(S{i}(:));
+    H=sparse(repmat((1:N)',T,1),e,1,N,max(e));
+    pers(i)=(sum(nonzeros(H).^2)-N*T)/(N*T*(T-1));
 end
 
 end
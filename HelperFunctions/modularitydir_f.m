@@ -1,4 +1,4 @@
-function [B,twom] = modularitydir_f(A,gamma)
+function [B,twom,D] = modularitydir_f(A,gamma)
 % MODULARITYDIR_F returns monolayer Leicht-Newman modularity matrix for directed network given by adjacency matrix A, function handle version
 %
 % Version: 2.2.0
@@ -12,10 +12,17 @@ function [B,twom] = modularitydir_f(A,gamma)
 %          [N]x[N] modularity matrix of the monolayer network
 %           with adjacency matrix A
 %           twom: normalisation constant
+%           D: struct describing the same modularity matrix by the
+%           symmetrised adjacency matrix and the in- and out-degrees, which
+%           GENLOUVAIN optimises natively without forming any columns
 %
 %   Example of usage: [B,twom]=modularitydir_f(A,gamma);
 %          [S,Q]= genlouvain(B);
 %          Q=Q/twom;
+%
+%          [~,twom,D]=modularitydir_f(A,gamma);
+%          [S,Q]= genlouvain(D);
+%          Q=Q/twom;
 %   Notes:
 %     The matrix A is assumed to be square. This assumption is not checked
 %     here.
@@ -47,4 +54,8 @@ A=(A+A')/2;
 
 B=@(i) full(A(:,i)-gamma/2*(k*d(i)+d'*k(i))/twom);
 
+if nargout>2
+    D=struct('A',A,'kin',k,'kout',d','layer',ones(length(A),1),'weight',gamma/(2*twom));
+end
+
 end
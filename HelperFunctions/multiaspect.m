@@ -1,4 +1,4 @@
-function [B, twom] = multiaspect(A, gamma, omega, type)
+function [B, twom] = multiaspect(A, gamma, omega, type, implicit)
 % MULTIASPECT  returns multilayer Newman-Girvan modularity matrix for multiple aspects.
 %
 % Aspects can be ordered or unordered, and the function supports different
@@ -22,6 +22,8 @@ function [B, twom] = multiaspect(A, gamma, omega, type)
 %                letters 'c' or 'm' and ordinal (temporal) coupling is
 %                specified using the letters 'o' or 't'.
 %
+%          implicit: optional flag 'implicit' to return the modularity
+%                matrix without its interlayer coupling (see below)
 %
 %   Output: B: [N x numel(A)]x[N x numel(A)] flattened modularity
 %              tensor for the multilayer network (note that numel(A) is the
@@ -39,6 +41,17 @@ function [B, twom] = multiaspect(A, gamma, omega, type)
 %          For a multiplex temporal network, one should have `ndims(A)==2`
 %          and `type='co'` (or `type='mt'`)
 %
+%          [D,twom]=multiaspect(A,gamma,omega,type,'implicit');
+%          [S,Q]= genlouvain(D);
+%          Q=Q/twom;
+%
+%          With 'implicit', B is a struct D with the block diagonal
+%          intralayer modularity matrix D.B and the aspect structure (D.N,
+%          D.aspects, D.type, D.omega). GENLOUVAIN generates the interlayer
+%          coupling from the aspect structure when it needs it, such that the
+%          coupling matrix (which can need more memory than the layers for
+%          several aspects) is never formed.
+%
 %   Notes:
 %     The matrices in the cell array A are assumed to be square,
 %     symmetric, and of equal size.  These assumptions are not checked here.
@@ -91,6 +104,15 @@ function [B, twom] = multiaspect(A, gamma, omega, type)
                          'UniformOutput', false);
     B=cellfun(@sparse,B,'UniformOutput',false);
     B = blkdiag(B{:});
+    if nargin>4 && strcmp(implicit, 'implicit')
+        N = length(A{1});
+        twom = sum([twom{:}]);
+        for a = 1:numel(aspects)
+            twom = twom + N*omega(a)*na/aspects(a)*sum(sum(coupling(aspects(a), type(a))));
+        end
+        B = struct('B', B, 'N', N, 'aspects', aspects, 'type', type, 'omega', omega(:));
+        return
+    end
     C = sparse(prod(aspects),prod(aspects));
     for a = 1:numel(aspects)
         C = C + kron(kron(speye(prod(aspects(a+1:end))),coupling(aspects(a), type(a))*omega(a)),...
@@ -1,4 +1,4 @@
-function [B,twomu] = multicatbipartite(A,gamma,omega)
+function [B,twomu,D] = multicatbipartite(A,gamma,omega)
 % MULTICATBIPARTITE  returns multilayer Barber modularity matrix for unordered undirected bipartite networks, matrix version
 %
 % Version: 2.2.0
@@ -15,6 +15,10 @@ function [B,twomu] = multicatbipartite(A,gamma,omega)
 %            multilayer bipartite network with uniform categorical coupling
 %            (T is the number of layers of the network)
 %         twomu: normalisation constant
+%         D: struct describing the same modularity matrix by the
+%            adjacency matrix (including interlayer coupling) and the degrees
+%            of both node classes in each layer, which GENLOUVAIN optimises
+%            natively without forming any columns (use [S,Q]=genlouvain(D))
 %
 % Usage: [B,twomu]=multicatbipartite(A,gamma,omega);
 %        [S,Q]=genlouvain(B); % see iterated_genlouvain.m and
@@ -104,4 +108,19 @@ end
 all2all = N*[(-T+1):-1,1:(T-1)];
 B = B + omega*spdiags(ones(N*T,2*T-2),all2all,N*T,N*T);
 twomu = 2*mu+(T-1)*T*N*omega;
+
+if nargout>2
+    kr=zeros(N,T);
+    kc=zeros(N,T);
+    Ab=cell(T,1);
+    for s=1:T
+        kr(1:m,s)=sum(A{s},2);
+        kc(m+1:N,s)=sum(A{s},1)';
+        Ab{s}=[sparse(m,m),sparse(A{s});sparse(A{s})',sparse(n,n)];
+    end
+    mm=sum(kr,1)';
+    w=gamma(:)./mm;
+    w(mm==0)=0;
+    D=struct('A',blkdiag(Ab{:})+omega*spdiags(ones(N*T,2*T-2),all2all,N*T,N*T),'krow',kr(:),'kcol',kc(:),'layer',kron((1:T)',ones(N,1)),'weight',w);
+end
 end
@@ -1,4 +1,4 @@
-function [B,twom] = multiordbipartite_f(A,gamma,omega)
+function [B,twom,D] = multiordbipartite_f(A,gamma,omega)
 % MULTIORDBIPARTITE_F  returns multilayer Barber modularity matrix for ordered undirected bipartite networks, function handle version
 %
 % Version: 2.2.0
@@ -16,6 +16,10 @@ function [B,twom] = multiordbipartite_f(A,gamma,omega)
 %            multilayer bipartite network with uniform ordinal coupling (T is
 %            the number of layers of the network)
 %         twomu: normalisation constant
+%         D: struct describing the same modularity matrix by the
+%            adjacency matrix (including interlayer coupling) and the degrees
+%            of both node classes in each layer, which GENLOUVAIN optimises
+%            natively without forming any columns (use [S,Q]=genlouvain(D))
 %
 % Usage: [B,twomu]=multiordbipartite_f(A,gamma,omega);
 %        [S,Q]=genlouvain(B); % see iterated_genlouvain.m and
@@ -128,4 +132,19 @@ C=omega*spdiags(ones(N*T,2),[-N,N],N*T,N*T);
 
 B=@modf;
 twom=2*twom+2*N*(T-1)*omega;
+
+if nargout>2
+    kr=zeros(N,T);
+    kc=zeros(N,T);
+    Ab=cell(T,1);
+    for s=1:T
+        kr(1:m,s)=sum(A{s},2);
+        kc(m+1:N,s)=sum(A{s},1)';
+        Ab{s}=[sparse(m,m),sparse(A{s});sparse(A{s})',sparse(n,n)];
+    end
+    mm=sum(kr,1)';
+    w=gamma(:)./mm;
+    w(mm==0)=0;
+    D=struct('A',blkdiag(Ab{:})+C,'krow',kr(:),'kcol',kc(:),'layer',kron((1:T)',ones(N,1)),'weight',w);
+end
 end
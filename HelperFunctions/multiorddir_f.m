@@ -1,4 +1,4 @@
-function [B,twom]=multiorddir_f(A,gamma,omega)
+function [B,twom,D]=multiorddir_f(A,gamma,omega)
 %MULTIORDDIR_F  returns multilayer Leicht-Newman modularity matrix for ordered directed layers, function handle version
 %
 % Version: 2.2.0
@@ -14,6 +14,11 @@ function [B,twom]=multiorddir_f(A,gamma,omega)
 %           multilayer network with uniform ordinal coupling (T is
 %           the number of layers of the network)
 %           twom: normalisation constant
+%           D: struct describing the same modularity matrix by the
+%           symmetrised adjacency matrix (including interlayer coupling)
+%           and the in- and out-degrees of each layer, which GENLOUVAIN
+%           optimises natively without forming any columns (use
+%           [S,Q]=genlouvain(D))
 %
 %   Example of usage: [B,twom]=multiorddir_f(A,gamma,omega);
 %          [S,Q]= genlouvain(B); % see iterated_genlouvain.m and
@@ -120,4 +125,8 @@ A=A+omega*spdiags(ones(N*T,2),[-N,N],N*T,N*T);
 B=@(i) A(:,i)-gamma(ceil(i./(N+eps))).*(kout(i).*kinmat(:,ceil(i./(N+eps)))+kin(i).*koutmat(:,ceil(i./(N+eps))))./(2*m(ceil(i./(N+eps))));
 
 twom=sum(m)+omega*2*N*(T-1);
+
+if nargout>2
+    D=struct('A',A,'kin',kin,'kout',kout','layer',kron((1:T)',ones(N,1)),'weight',gamma(:)./(2*m));
+end
 end
@@ -28,6 +28,12 @@ function pers=ordinal_persistence(S)
 %     Interdisciplinary Journal 14, 1-41 (2016).
 
 
+if exist('multilayer_handler','file')==3
+    % native version (counts label agreements for each node directly)
+    pers=multilayer_handler('persistence_ordinal',S);
+    return
+end
+
 if ~iscell(S)
     S={S};
 end
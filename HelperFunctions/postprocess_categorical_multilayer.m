@@ -39,6 +39,11 @@ function S=postprocess_categorical_multilayer(S,T,max_coms,verbose)
 % ordinal case it is not guaranteed to have optimal persistence for the
 % given intralayer community assignments.
 %
+% If the mex function 'multilayer_handler' is available (see compile_mex.m),
+% the assignment problems for all layers are solved in parallel given the
+% current assignment of the other layers and the resulting relabelings are
+% applied in random order as long as they still increase persistence.
+%
 %   References:
 %
 %     Mucha, Peter J., Thomas Richardson, Kevin Macon, Mason A. Porter, and
@@ -78,46 +83,58 @@ if max(S(:))<max_coms % don't do anything if too many communities for performanc
 % tidy assignment
 [~,~,S]=unique(S);
 S=reshape(S,N,T);
-S_new=S;
+if exist('multilayer_handler','file')==3
+    % native version (solves assignment problems for all layers in parallel)
+    if verbose
+        p0=categorical_persistence(S);
+    end
+    S=multilayer_handler('postprocess_categorical',S);
+    if verbose
+        p1=categorical_persistence(S);
+        mydisp(sprintf('improvement found: %g',p1-p0));
+    end
+else
+    S_new=S;
 
-p0=-inf;
-p1=categorical_persistence(S); % checking
+    p0=-inf;
+    p1=categorical_persistence(S); % checking
 
-while (p1-p0)>0
-    p0=p1;
-    % only update if improvement found (don't update in degenerate case
-    % where change in persistence is 0)
-    S=S_new;
-    max_com=max(S_new(:));
-    order=randperm(T);
-    for i=order
-        [ui,~,ei]=unique(S_new(:,i));
-        Gi=sparse(1:length(ei),ei,true);
-        c=1:T;
-        c(i)=[];
-        [uc,~,ec]=unique(S_new(:,c));
-        ec=reshape(ec,N,T-1);
-        overlap=zeros(length(ui),length(uc));
-        for j=1:length(ui)
-            ecj=ec(Gi(:,j),:);
-            Gc=sparse(1:numel(ecj),ecj(:),1,numel(ecj),length(uc));
-            overlap(j,:)=full(sum(Gc,1));
-        end
-        dist=sum(overlap(:))-overlap;
-        S2=assignmentoptimal(dist);
+    while (p1-p0)>0
+        p0=p1;
+        % only update if improvement found (don't update in degenerate case
+        % where change in persistence is 0)
+        S=S_new;
+        max_com=max(S_new(:));
+        order=randperm(T);
+        for i=order
+            [ui,~,ei]=unique(S_new(:,i));
+            Gi=sparse(1:length(ei),ei,true);
+            c=1:T;
+            c(i)=[];
+            [uc,~,ec]=unique(S_new(:,c));
+            ec=reshape(ec,N,T-1);
+            overlap=zeros(length(ui),length(uc));
+            for j=1:length(ui)
+                ecj=ec(Gi(:,j),:);
+                Gc=sparse(1:numel(ecj),ecj(:),1,numel(ecj),length(uc));
+                overlap(j,:)=full(sum(Gc,1));
+            end
+            dist=sum(overlap(:))-overlap;
+            S2=assignmentoptimal(dist);
 
-        for j=1:length(ui)
-        if S2(j)~=0&&overlap(j,S2(j))>0
-            S_new(Gi(:,j),i)=uc(S2(j)); % update assignment
-        else
-            S_new(Gi(:,j),i)=max_com+1; % get new label if not assigned
-            max_com=max_com+1;
-        end
+            for j=1:length(ui)
+            if S2(j)~=0&&overlap(j,S2(j))>0
+                S_new(Gi(:,j),i)=uc(S2(j)); % update assignment
+            else
+                S_new(Gi(:,j),i)=max_com+1; % get new label if not assigned
+                max_com=max_com+1;
+            end
+            end
         end
-    end
-    p1=categorical_persistence(S_new);
+        p1=categorical_persistence(S_new);
 
-    mydisp(sprintf('improvement found: %g',p1-p0));
+        mydisp(sprintf('improvement found: %g',p1-p0));
+    end
 end
 
 % return in original format
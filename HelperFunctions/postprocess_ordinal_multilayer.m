@@ -41,6 +41,10 @@ function S=postprocess_ordinal_multilayer(S,T,max_coms,verbose)
 % particularly useful when using the multilayer quality function in
 % Mucha et al. 2010 with low values of ordinal uniform interlayer coupling.
 %
+% If the mex function 'multilayer_handler' is available (see compile_mex.m),
+% the assignment problems for all pairs of consecutive layers are solved in
+% parallel.
+%
 %   References:
 %
 %     Mucha, Peter J., Thomas Richardson, Kevin Macon, Mason A. Porter, and
@@ -83,24 +87,12 @@ if max(S(:))<max_coms % don't do anything if too many communities for performanc
     if verbose
         p0=ordinal_persistence(S);
     end
-    max_com=max(S(:,1));
-    for i=2:T
-        [u1,~,e1]=unique(S(:,i-1)); % unique communities in previous layer
-        [u2,~,e2]=unique(S(:,i)); % unique communities in this layer
-        G1=sparse(e1,1:length(e1),1); % community assignment matrix for previous layer
-        G2=sparse(1:length(e2),e2,true); % community assignment matrix for this layer
-        overlap=G1*G2; % node overlap matrix between communities in the two layers
-        dist=sum(overlap(:))-overlap;
-        S2=assignmentoptimal(dist'); % find best assignment for communities in current layer
-
-        for j=1:length(u2)
-            if S2(j)~=0&&overlap(S2(j),j)
-                S(G2(:,j),i)=u1(S2(j)); % update assignment
-            else
-                S(G2(:,j),i)=max_com+1; % get new label if not assigned
-                max_com=max_com+1;
-            end
-        end
+    if exist('multilayer_handler','file')==3
+        % native version (solves assignment problems for all pairs of
+        % layers in parallel)
+        S=multilayer_handler('postprocess_ordinal',S);
+    else
+        S=relabel_layers(S,T);
     end
     if verbose
         p1=ordinal_persistence(S);
@@ -113,3 +105,28 @@ end
 % return in original format
 S=reshape(S,N0,T0);
 end
+
+%-----%
+function S=relabel_layers(S,T)
+% sequential relabeling of consecutive layers (used if the mex file is not
+% available)
+max_com=max(S(:,1));
+for i=2:T
+    [u1,~,e1]=unique(S(:,i-1)); % unique communities in previous layer
+    [u2,~,e2]=unique(S(:,i)); % unique communities in this layer
+    G1=sparse(e1,1:length(e1),1); % community assignment matrix for previous layer
+    G2=sparse(1:length(e2),e2,true); % community assignment matrix for this layer
+    overlap=G1*G2; % node overlap matrix between communities in the two layers
+    dist=sum(overlap(:))-overlap;
+    S2=assignmentoptimal(dist'); % find best assignment for communities in current layer
+
+    for j=1:length(u2)
+        if S2(j)~=0&&overlap(S2(j),j)
+            S(G2(:,j),i)=u1(S2(j)); % update assignment
+        else
+            S(G2(:,j),i)=max_com+1; % get new label if not assigned
+            max_com=max_com+1;
+        end
+    end
+end
+end
@@ -0,0 +1,98 @@
+//
+//  arena.cpp
+//  arena
+//
+//  Implements the engine arena.
+//
+//
+// Version: 2.2.0
+
+#include "arena.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+//allocations are rounded up to keep every pointer aligned, new blocks at least double the arena
+static const size_t arena_alignment=alignof(max_align_t);
+static const size_t arena_min_block=1<<16;
+
+arena::arena() : current(0), offset(0) {}
+
+void * arena::allocate_bytes(size_t n_bytes){
+    size_t bytes=(n_bytes+arena_alignment-1)/arena_alignment*arena_alignment;
+    while (current<blocks.size()) {
+        if (offset+bytes<=block_size[current]) {
+            void * p=blocks[current].get()+offset;
+            offset+=bytes;
+            return p;
+        }
+        ++current;
+        offset=0;
+    }
+    size_t size=max(max(bytes, arena_min_block), this->bytes());
+    blocks.push_back(unique_ptr<char[]>(new char[size]));
+    block_size.push_back(size);
+    current=blocks.size()-1;
+    offset=bytes;
+    return blocks.back().get();
+}
+
+void arena::rewind(){
+    current=0;
+    offset=0;
+}
+
+void arena::reset(){
+    if (blocks.size()>1) {
+        size_t total=bytes();
+        blocks.clear();
+        block_size.clear();
+        blocks.push_back(unique_ptr<char[]>(new char[total]));
+        block_size.push_back(total);
+    }
+    rewind();
+}
+
+size_t arena::bytes() const {
+    size_t total=0;
+    for (mwIndex b=0; b<block_size.size(); ++b) {
+        total+=block_size[b];
+    }
+    return total;
+}
+
+sparse arena_sparse(arena & a, mwSize m, mwSize n, mwSize nmax){
+    mwIndex * row=a.allocate<mwIndex>(nmax);
+    mwIndex * col=a.allocate<mwIndex>(n+1);
+    double * val=a.allocate<double>(nmax);
+    fill(row, row+nmax, 0);
+    fill(col, col+n+1, 0);
+    fill(val, val+nmax, 0);
+    return sparse(m, n, nmax, row, col, val);
+}
+
+full arena_full(arena & a, mwSize m, mwSize n){
+    double * val=a.allocate<double>(m*n);
+    fill(val, val+m*n, 0);
+    return full(m, n, val);
+}
+
+vector<sparse> arena_sparse_columns(arena & a, mwSize count, mwSize m, mwSize nmax){
+    vector<sparse> cols;
+    cols.reserve(count);
+    for (mwIndex c=0; c<count; ++c) {
+        cols.push_back(arena_sparse(a, m, 1, nmax));
+    }
+    return cols;
+}
+
+vector<full> arena_full_columns(arena & a, mwSize count, mwSize m){
+    vector<full> cols;
+    cols.reserve(count);
+    for (mwIndex c=0; c<count; ++c) {
+        cols.push_back(arena_full(a, m, 1));
+    }
+    return cols;
+}
@@ -0,0 +1,76 @@
+//
+//  arena.h
+//  arena
+//
+//  Bump allocator for the temporaries of an engine (column buffers of the move handles). Memory
+//  is taken from a list of blocks and never freed individually:
+//
+//      allocate<T>(n): uninitialised storage for n values of type T (aligned for any type, valid
+//              until the next rewind or reset)
+//
+//      rewind(): invalidates all allocations but keeps the blocks, handles rewind the arena
+//              before taking their buffers so that repeated passes reuse the same memory
+//
+//      reset(): rewinds and merges the blocks into a single block of their total size (called
+//              when a new level starts, after the first pass of a level the arena no longer
+//              allocates)
+//
+//      arena_sparse(a, m, n, nmax), arena_full(a, m, n): zero-initialised matrices wrapping
+//              arena memory (the wrappers do not own the memory and are moved, not copied)
+//
+//      arena_sparse_columns(a, count, m, nmax), arena_full_columns(a, count, m): count m x 1
+//              columns (one per worker thread)
+//
+//  The arena only uses std containers and does not call the MATLAB API, an engine used by a
+//  worker thread can use its own arena.
+//
+//
+// Version: 2.2.0
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+struct arena{
+    arena();
+
+    void * allocate_bytes(std::size_t bytes);
+
+    template<class T> T * allocate(mwSize n){
+        return static_cast<T *>(allocate_bytes(n*sizeof(T)));
+    }
+
+    void rewind();
+
+    void reset();
+
+    std::size_t bytes() const; //total size of the blocks
+
+private:
+    std::vector<std::unique_ptr<char[]> > blocks;
+    std::vector<std::size_t> block_size;
+    mwIndex current; //block used for the next allocation
+    std::size_t offset; //first free byte in the current block
+};
+
+sparse arena_sparse(arena & a, mwSize m, mwSize n, mwSize nmax);
+
+full arena_full(arena & a, mwSize m, mwSize n);
+
+std::vector<sparse> arena_sparse_columns(arena & a, mwSize count, mwSize m, mwSize nmax);
+
+std::vector<full> arena_full_columns(arena & a, mwSize count, mwSize m);
+
+#endif
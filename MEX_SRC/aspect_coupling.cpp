@@ -0,0 +1,96 @@
+//
+//  aspect_coupling.cpp
+//  aspect_coupling
+//
+//  Implements the implicit multiaspect coupling.
+//
+//
+// Version: 2.2.0
+
+#include "aspect_coupling.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+aspect_coupling::aspect_coupling() : N(0), n_layers(1) {}
+
+void aspect_coupling::assign(mwSize N_in, const full & sizes, const string & types, const full & omega_in){
+    mwSize d=sizes.m*sizes.n;
+    if (types.size()!=d||omega_in.m*omega_in.n!=d) {
+        mexErrMsgIdAndTxt("aspect_coupling:assign", "need one coupling type and one coupling strength per aspect");
+    }
+    N=N_in;
+    n_layers=1;
+    size.resize(d);
+    stride.resize(d);
+    categorical.resize(d);
+    omega.resize(d);
+    for (mwIndex a=0; a<d; ++a) {
+        if (!(sizes.get(a)>=1)) {
+            mexErrMsgIdAndTxt("aspect_coupling:assign", "aspect sizes need to be positive");
+        }
+        size[a]=(mwSize) sizes.get(a);
+        stride[a]=n_layers;
+        n_layers*=size[a];
+        switch (types[a]) {
+            case 'c':
+            case 'm':
+                categorical[a]=true;
+                break;
+            case 'o':
+            case 't':
+                categorical[a]=false;
+                break;
+            default:
+                mexErrMsgIdAndTxt("aspect_coupling:assign", "unknown aspect type %c", types[a]);
+        }
+        omega[a]=omega_in.get(a);
+    }
+}
+
+mwSize aspect_coupling::max_coupled() const {
+    mwSize n_coupled=0;
+    for (mwIndex a=0; a<size.size(); ++a) {
+        n_coupled+=categorical[a] ? size[a]-1 : min(size[a]-1, (mwSize) 2);
+    }
+    return n_coupled;
+}
+
+mwSize aspect_coupling::coupled(mwIndex node, mwIndex * row, double * val) const {
+    mwIndex layer=node/N;
+    mwIndex offset=node%N;
+    mwSize c=0;
+    for (mwIndex a=0; a<size.size(); ++a) {
+        if (omega[a]==0) {
+            continue;
+        }
+        mwIndex x=(layer/stride[a])%size[a];
+        mwIndex base=layer-x*stride[a];
+        mwIndex begin=(categorical[a]||x==0) ? 0 : x-1;
+        mwIndex end=(categorical[a]||x+1==size[a]) ? size[a] : x+2;
+        for (mwIndex y=begin; y<end; ++y) {
+            if (y!=x) {
+                row[c]=(base+y*stride[a])*N+offset;
+                val[c]=omega[a];
+                ++c;
+            }
+        }
+    }
+
+    //layers differ in a single aspect, so rows are distinct and only need sorting (insertion
+    //sort in place, the number of coupled copies is small)
+    for (mwIndex k=1; k<c; ++k) {
+        mwIndex r=row[k];
+        double v=val[k];
+        mwIndex l=k;
+        for (; l>0&&row[l-1]>r; --l) {
+            row[l]=row[l-1];
+            val[l]=val[l-1];
+        }
+        row[l]=r;
+        val[l]=v;
+    }
+    return c;
+}
@@ -0,0 +1,113 @@
+//
+//  aspect_coupling.h
+//  aspect_coupling
+//
+//  Interlayer coupling of a multiaspect network generated from index arithmetic (the coupling
+//  matrix C of multiaspect.m is never formed):
+//
+//      A network with N nodes and aspects of sizes L(1),...,L(d) has N*prod(L) state nodes, state
+//      node i+N*l (0-based) is the copy of node i in layer l, and layer l has aspect indices
+//      x(a)=floor(l/stride(a)) mod L(a) with stride(a)=L(1)*...*L(a-1). Two copies of the same
+//      node are coupled with weight omega(a) if their layers only differ in aspect a, for
+//      categorical aspects ('c' or 'm') for any two values, for ordinal aspects ('o' or 't')
+//      for neighbouring values.
+//
+//      assign(N, sizes, types, omega): sets the aspect structure (types has one character per
+//              aspect, omega one value per aspect)
+//
+//      coupled(node, row, val): writes the state nodes coupled to node (in increasing order)
+//              and the coupling weights to row and val and returns their number (at most
+//              max_coupled())
+//
+//      aspect_matrix: column access to B+C for the intralayer modularity matrix B (sparse or
+//              symmetric_sparse), can be used wherever the engine takes a matrix of that type
+//              (the column buffer is allocated at construction, so column() is only used by the
+//              thread that constructed the matrix)
+//
+//
+// Version: 2.2.0
+
+#ifndef ASPECT_COUPLING_H
+#define ASPECT_COUPLING_H
+
+#include <vector>
+#include <string>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+struct aspect_coupling{
+    aspect_coupling();
+
+    void assign(mwSize N, const full & sizes, const std::string & types, const full & omega);
+
+    mwSize n_nodes() const { return N*n_layers; }
+
+    mwSize max_coupled() const;
+
+    mwSize coupled(mwIndex node, mwIndex * row, double * val) const;
+
+    mwSize N;
+    mwSize n_layers;
+    std::vector<mwSize> size;
+    std::vector<mwSize> stride;
+    std::vector<bool> categorical;
+    std::vector<double> omega;
+};
+
+//M is sparse or symmetric_sparse
+template<class M> struct aspect_matrix{
+    aspect_matrix(const M & intra, const aspect_coupling & coupling) : m(intra.m), n(intra.n), intra(intra), coupling(coupling), intra_col(intra.m, 1, intra.max_col_nzero()), coupled_row(coupling.max_coupled()), coupled_val(coupling.max_coupled()) {
+        if (intra.m!=coupling.n_nodes()||intra.n!=coupling.n_nodes()) {
+            mexErrMsgIdAndTxt("aspect_matrix:constructor", "intralayer modularity matrix does not match the aspect sizes");
+        }
+    }
+
+    mwSize max_col_nzero() const { return intra.max_col_nzero()+coupling.max_coupled(); }
+
+    //merge column j of the intralayer matrix with the coupling of j (rows in increasing order)
+    void column(mwIndex j, sparse & out) const {
+        intra.column(j, intra_col);
+        mwSize n_coupled=coupling.coupled(j, coupled_row.data(), coupled_val.data());
+        mwIndex a=0;
+        mwIndex b=0;
+        mwIndex c=0;
+        while (a<intra_col.nzero()||b<n_coupled) {
+            if (b==n_coupled||(a<intra_col.nzero()&&intra_col.row[a]<coupled_row[b])) {
+                out.row[c]=intra_col.row[a];
+                out.val[c]=intra_col.val[a++];
+            }
+            else if (a==intra_col.nzero()||coupled_row[b]<intra_col.row[a]) {
+                out.row[c]=coupled_row[b];
+                out.val[c]=coupled_val[b++];
+            }
+            else {
+                out.row[c]=intra_col.row[a];
+                out.val[c]=intra_col.val[a++]+coupled_val[b++];
+            }
+            ++c;
+        }
+        out.m=m;
+        out.n=1;
+        out.col[0]=0;
+        out.col[1]=c;
+    }
+
+    mwSize m;
+    mwSize n;
+    const M & intra;
+    const aspect_coupling & coupling;
+
+private:
+    mutable sparse intra_col;
+    mutable std::vector<mwIndex> coupled_row;
+    mutable std::vector<double> coupled_val;
+};
+
+#endif
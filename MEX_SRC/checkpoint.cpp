@@ -0,0 +1,224 @@
+//
+//  checkpoint.cpp
+//  checkpoint
+//
+//  Implements binary checkpoints. File layout (all integers are stored as uint64):
+//
+//      magic "GENLOUVAIN_CKPT" (16 bytes including terminating zero), format version
+//      length and characters of the random number generator state
+//      number of fields, then for each field:
+//          length and characters of the field name, type (0: full, 1: sparse, 2: char), m, n
+//          full:   m*n doubles
+//          sparse: nnz, n+1 column pointers, nnz row indeces, nnz doubles
+//          char:   m*n uint16 characters
+//
+//
+// Version: 2.2.0
+
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+static const char magic[16]="GENLOUVAIN_CKPT";
+static const uint64_t format_version=1;
+
+enum field_type {FULL_FIELD, SPARSE_FIELD, CHAR_FIELD};
+
+
+//file that is closed when going out of scope
+struct checkpoint_file {
+    checkpoint_file(const char * filename, const char * mode) : fp(fopen(filename, mode)) {}
+    ~checkpoint_file() { if (fp) fclose(fp); }
+    FILE * fp;
+};
+
+
+static void write_raw(FILE * fp, const void * data, size_t size, size_t count) {
+    if (count>0&&fwrite(data, size, count, fp)!=count) {
+        mexErrMsgIdAndTxt("checkpoint:write", "failed to write checkpoint");
+    }
+}
+
+static void write_uint(FILE * fp, uint64_t value) {
+    write_raw(fp, &value, sizeof(uint64_t), 1);
+}
+
+static void write_string(FILE * fp, const string & str) {
+    write_uint(fp, str.size());
+    write_raw(fp, str.data(), 1, str.size());
+}
+
+
+static void read_raw(FILE * fp, void * data, size_t size, size_t count) {
+    if (count>0&&fread(data, size, count, fp)!=count) {
+        mexErrMsgIdAndTxt("checkpoint:read", "checkpoint file is truncated or corrupted");
+    }
+}
+
+static uint64_t read_uint(FILE * fp) {
+    uint64_t value;
+    read_raw(fp, &value, sizeof(uint64_t), 1);
+    return value;
+}
+
+static string read_string(FILE * fp) {
+    string str(read_uint(fp), '\0');
+    if (!str.empty()) {
+        read_raw(fp, &str[0], 1, str.size());
+    }
+    return str;
+}
+
+
+static void write_field(FILE * fp, const char * name, const mxArray * value) {
+    uint64_t m=mxGetM(value);
+    uint64_t n=mxGetN(value);
+    write_string(fp, name);
+    if (mxIsDouble(value)&&mxIsSparse(value)) {
+        write_uint(fp, SPARSE_FIELD);
+        write_uint(fp, m);
+        write_uint(fp, n);
+        const mwIndex * jc=mxGetJc(value);
+        const mwIndex * ir=mxGetIr(value);
+        uint64_t nnz=jc[n];
+        write_uint(fp, nnz);
+        for (mwIndex j=0; j<=n; ++j) {
+            write_uint(fp, jc[j]);
+        }
+        for (mwIndex i=0; i<nnz; ++i) {
+            write_uint(fp, ir[i]);
+        }
+        write_raw(fp, mxGetPr(value), sizeof(double), nnz);
+    }
+    else if (mxIsDouble(value)) {
+        write_uint(fp, FULL_FIELD);
+        write_uint(fp, m);
+        write_uint(fp, n);
+        write_raw(fp, mxGetPr(value), sizeof(double), m*n);
+    }
+    else if (mxIsChar(value)) {
+        write_uint(fp, CHAR_FIELD);
+        write_uint(fp, m);
+        write_uint(fp, n);
+        const mxChar * chars=static_cast<const mxChar *>(mxGetData(value));
+        vector<uint16_t> buffer(chars, chars+m*n);
+        write_raw(fp, buffer.data(), sizeof(uint16_t), m*n);
+    }
+    else {
+        mexErrMsgIdAndTxt("checkpoint:write", "field '%s' needs to be a real double matrix or a char array", name);
+    }
+}
+
+
+static mxArray * read_field(FILE * fp) {
+    uint64_t type=read_uint(fp);
+    mwSize m=read_uint(fp);
+    mwSize n=read_uint(fp);
+    mxArray * value=NULL;
+    switch (type) {
+        case FULL_FIELD: {
+            value=mxCreateDoubleMatrix(m, n, mxREAL);
+            read_raw(fp, mxGetPr(value), sizeof(double), m*n);
+            break;
+        }
+        case SPARSE_FIELD: {
+            mwSize nnz=read_uint(fp);
+            value=mxCreateSparse(m, n, nnz>0 ? nnz : 1, mxREAL);
+            mwIndex * jc=mxGetJc(value);
+            mwIndex * ir=mxGetIr(value);
+            for (mwIndex j=0; j<=n; ++j) {
+                jc[j]=read_uint(fp);
+            }
+            for (mwIndex i=0; i<nnz; ++i) {
+                ir[i]=read_uint(fp);
+                if (!(ir[i]<m)) {
+                    mexErrMsgIdAndTxt("checkpoint:read", "checkpoint file is corrupted");
+                }
+            }
+            if (jc[0]!=0||jc[n]!=nnz) {
+                mexErrMsgIdAndTxt("checkpoint:read", "checkpoint file is corrupted");
+            }
+            read_raw(fp, mxGetPr(value), sizeof(double), nnz);
+            break;
+        }
+        case CHAR_FIELD: {
+            vector<uint16_t> buffer(m*n);
+            read_raw(fp, buffer.data(), sizeof(uint16_t), m*n);
+            mwSize dims[2]={m, n};
+            value=mxCreateCharArray(2, dims);
+            mxChar * chars=static_cast<mxChar *>(mxGetData(value));
+            for (mwIndex i=0; i<m*n; ++i) {
+                chars[i]=buffer[i];
+            }
+            break;
+        }
+        default: {
+            mexErrMsgIdAndTxt("checkpoint:read", "checkpoint file is corrupted");
+        }
+    }
+    return value;
+}
+
+
+void write_checkpoint(const char * filename, const mxArray * state, const string & rng_state) {
+    if (!mxIsStruct(state)||mxGetNumberOfElements(state)!=1) {
+        mexErrMsgIdAndTxt("checkpoint:write", "state needs to be a scalar struct");
+    }
+    string tmp_name=string(filename)+".tmp";
+    {
+        checkpoint_file file(tmp_name.c_str(), "wb");
+        if (!file.fp) {
+            mexErrMsgIdAndTxt("checkpoint:write", "cannot open '%s' for writing", tmp_name.c_str());
+        }
+        write_raw(file.fp, magic, 1, sizeof(magic));
+        write_uint(file.fp, format_version);
+        write_string(file.fp, rng_state);
+        int n_fields=mxGetNumberOfFields(state);
+        write_uint(file.fp, n_fields);
+        for (int f=0; f<n_fields; ++f) {
+            const char * name=mxGetFieldNameByNumber(state, f);
+            write_field(file.fp, name, mxGetField(state, 0, name));
+        }
+        if (fflush(file.fp)) {
+            mexErrMsgIdAndTxt("checkpoint:write", "failed to write checkpoint");
+        }
+    }
+#ifdef _WIN32
+    //rename does not replace existing files on windows
+    remove(filename);
+#endif
+    if (rename(tmp_name.c_str(), filename)) {
+        mexErrMsgIdAndTxt("checkpoint:write", "cannot rename '%s' to '%s'", tmp_name.c_str(), filename);
+    }
+}
+
+
+mxArray * read_checkpoint(const char * filename, string & rng_state) {
+    checkpoint_file file(filename, "rb");
+    if (!file.fp) {
+        mexErrMsgIdAndTxt("checkpoint:read", "cannot open '%s' for reading", filename);
+    }
+    char header[sizeof(magic)];
+    read_raw(file.fp, header, 1, sizeof(magic));
+    if (memcmp(header, magic, sizeof(magic))) {
+        mexErrMsgIdAndTxt("checkpoint:read", "'%s' is not a GenLouvain checkpoint", filename);
+    }
+    if (read_uint(file.fp)!=format_version) {
+        mexErrMsgIdAndTxt("checkpoint:read", "unsupported checkpoint version");
+    }
+    rng_state=read_string(file.fp);
+    
+    mxArray * state=mxCreateStructMatrix(1, 1, 0, NULL);
+    uint64_t n_fields=read_uint(file.fp);
+    for (uint64_t f=0; f<n_fields; ++f) {
+        string name=read_string(file.fp);
+        mxAddField(state, name.c_str());
+        mxSetField(state, 0, name.c_str(), read_field(file.fp));
+    }
+    return state;
+}
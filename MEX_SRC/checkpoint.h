@@ -0,0 +1,35 @@
+//
+//  checkpoint.h
+//  checkpoint
+//
+//  Compact binary checkpoints of the state of a run:
+//
+//      write_checkpoint(filename, state, rng_state): writes the fields of the scalar struct
+//              state (full or sparse double matrices and char arrays) and the state of the
+//              random number generator of the engine to file. The file is written to a
+//              temporary file first and then renamed, such that an interrupted write never
+//              leaves a corrupted checkpoint behind.
+//
+//      read_checkpoint(filename, rng_state): reads a checkpoint and returns the state struct
+//              (rng_state is set to the stored state of the random number generator)
+//
+//
+// Version: 2.2.0
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+
+void write_checkpoint(const char * filename, const mxArray * state, const std::string & rng_state);
+
+mxArray * read_checkpoint(const char * filename, std::string & rng_state);
+
+#endif
@@ -0,0 +1,130 @@
+//
+//  column_cache.cpp
+//  column_cache
+//
+//  Implements the CLOCK column cache.
+//
+//
+// Version: 2.2.0
+
+#include "column_cache.h"
+
+using namespace std;
+
+
+column_cache::entry::entry() : valid(false), referenced(false), node(0) {}
+
+column_cache::column_cache() : n(0), max_bytes(0), used_bytes(0), hits(0), misses(0), hand(0) {}
+
+void column_cache::reset(mwSize n_in, double max_bytes_in){
+    n=n_in;
+    max_bytes=max_bytes_in;
+    used_bytes=0;
+    slots.clear();
+    free_slots.clear();
+    slot_of.assign(n, 0);
+    hand=0;
+}
+
+bool column_cache::get(mwIndex node, sparse & out){
+    if (!(node<n)||slot_of[node]>=slots.size()||!slots[slot_of[node]].valid||slots[slot_of[node]].node!=node) {
+        ++misses;
+        return false;
+    }
+    entry & e=slots[slot_of[node]];
+    e.referenced=true;
+    for (mwIndex i=0; i<e.row.size(); ++i) {
+        out.row[i]=e.row[i];
+        out.val[i]=e.val[i];
+    }
+    out.m=n;
+    out.n=1;
+    out.col[0]=0;
+    out.col[1]=e.row.size();
+    ++hits;
+    return true;
+}
+
+void column_cache::insert(mwIndex node, const sparse & col){
+    mwSize nzero=col.nzero();
+    double bytes=entry_bytes(nzero);
+    if (!(node<n)||bytes>max_bytes) {
+        return;
+    }
+    entry & e=slots[allocate(bytes)];
+    e.row.assign(col.row, col.row+nzero);
+    e.val.assign(col.val, col.val+nzero);
+    e.node=node;
+    slot_of[node]=&e-slots.data();
+    used_bytes+=bytes;
+}
+
+void column_cache::insert(mwIndex node, const full & col){
+    mwSize nzero=0;
+    for (mwIndex i=0; i<col.m; ++i) {
+        if (col.get(i)!=0) {
+            ++nzero;
+        }
+    }
+    double bytes=entry_bytes(nzero);
+    if (!(node<n)||bytes>max_bytes) {
+        return;
+    }
+    entry & e=slots[allocate(bytes)];
+    e.row.clear();
+    e.val.clear();
+    for (mwIndex i=0; i<col.m; ++i) {
+        if (col.get(i)!=0) {
+            e.row.push_back(i);
+            e.val.push_back(col.get(i));
+        }
+    }
+    e.node=node;
+    slot_of[node]=&e-slots.data();
+    used_bytes+=bytes;
+}
+
+double column_cache::entry_bytes(mwSize nzero) const {
+    return (double) (nzero*(sizeof(mwIndex)+sizeof(double))+sizeof(entry));
+}
+
+mwIndex column_cache::allocate(double bytes){
+    while (used_bytes+bytes>max_bytes) {
+        evict();
+    }
+    mwIndex slot;
+    if (free_slots.empty()) {
+        slot=slots.size();
+        slots.push_back(entry());
+    }
+    else {
+        slot=free_slots.back();
+        free_slots.pop_back();
+    }
+    slots[slot].valid=true;
+    slots[slot].referenced=false;
+    return slot;
+}
+
+void column_cache::evict(){
+    //at least one entry is valid when eviction is needed, so this terminates after two rounds
+    while (true) {
+        if (hand>=slots.size()) {
+            hand=0;
+        }
+        entry & e=slots[hand++];
+        if (!e.valid) {
+            continue;
+        }
+        if (e.referenced) {
+            e.referenced=false;
+            continue;
+        }
+        e.valid=false;
+        used_bytes-=entry_bytes(e.row.size());
+        vector<mwIndex>().swap(e.row);
+        vector<double>().swap(e.val);
+        free_slots.push_back(&e-slots.data());
+        return;
+    }
+}
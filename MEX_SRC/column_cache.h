@@ -0,0 +1,76 @@
+//
+//  column_cache.h
+//  column_cache
+//
+//  Bounded-memory cache of compressed columns of the modularity matrix of the current level
+//  (used when columns are computed by a function handle). Entries are evicted with the CLOCK
+//  algorithm (approximate LRU): each access sets a reference bit, the clock hand clears
+//  reference bits and evicts the first entry without one.
+//
+//      reset(n, max_bytes): clears the cache for a level with n nodes and sets the memory cap
+//
+//      get(node, out): copies the cached column of node into out (out.nmax needs to be at least
+//                      n) and returns true, returns false if the column is not cached
+//
+//      insert(node, col): adds column col of node (sparse or full, zeros are not stored),
+//                         evicting entries as needed to stay below the memory cap
+//
+//  The cache only uses std containers and does not call the MATLAB API.
+//
+//
+// Version: 2.2.0
+
+#ifndef COLUMN_CACHE_H
+#define COLUMN_CACHE_H
+
+#include <vector>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+struct column_cache{
+    column_cache();
+
+    void reset(mwSize n, double max_bytes);
+
+    bool get(mwIndex node, sparse & out);
+
+    void insert(mwIndex node, const sparse & col);
+
+    void insert(mwIndex node, const full & col);
+
+    struct entry{
+        entry();
+        bool valid;
+        bool referenced;
+        mwIndex node;
+        std::vector<mwIndex> row;
+        std::vector<double> val;
+    };
+
+    mwSize n;
+    double max_bytes;
+    double used_bytes;
+    double hits;
+    double misses;
+
+    std::vector<entry> slots;
+    std::vector<mwIndex> slot_of; //last slot of each node (only valid if the slot still holds node)
+    std::vector<mwIndex> free_slots;
+    mwIndex hand;
+
+private:
+    double entry_bytes(mwSize nzero) const;
+
+    mwIndex allocate(double bytes); //evicts entries until bytes fit and returns a free slot
+
+    void evict();
+};
+
+#endif
@@ -11,17 +11,21 @@ switch ext
         arraydims='-largeArrayDims';
 end
 mkdir('../private');
+mkdir('../HelperFunctions/private');
 setenv('CXXFLAGS',[getenv('CXXFLAGS'),' -std=c++11 -O4']);
 if exist('OCTAVE_VERSION','builtin')
-    mex -DOCTAVE -Imatlab_matrix metanetwork_reduce.cpp matlab_matrix/full.cpp matlab_matrix/sparse.cpp group_index.cpp
-    mex -DOCTAVE -Imatlab_matrix group_handler.cpp matlab_matrix/full.cpp matlab_matrix/sparse.cpp group_index.cpp
+    mex -DOCTAVE -Imatlab_matrix metanetwork_reduce.cpp matlab_matrix/full.cpp matlab_matrix/sparse.cpp matlab_matrix/symmetric_sparse.cpp group_index.cpp
+    mex -DOCTAVE -Imatlab_matrix group_handler.cpp matlab_matrix/full.cpp matlab_matrix/sparse.cpp matlab_matrix/symmetric_sparse.cpp group_index.cpp gain_kernel.cpp reorder.cpp components.cpp column_cache.cpp arena.cpp directed.cpp aspect_coupling.cpp checkpoint.cpp quality.cpp multilayer.cpp hungarian.cpp
+    mex -DOCTAVE -Imatlab_matrix multilayer_handler.cpp multilayer.cpp hungarian.cpp matlab_matrix/full.cpp matlab_matrix/sparse.cpp matlab_matrix/symmetric_sparse.cpp
     mex -DOCTAVE ../Assignment/assignmentoptimal.c
 else
-    mex(arraydims,'-Imatlab_matrix','metanetwork_reduce.cpp', 'matlab_matrix/full.cpp', 'matlab_matrix/sparse.cpp', 'group_index.cpp')
-    mex(arraydims,'-Imatlab_matrix', 'group_handler.cpp', 'matlab_matrix/full.cpp', 'matlab_matrix/sparse.cpp', 'group_index.cpp')
+    mex(arraydims,'-Imatlab_matrix','metanetwork_reduce.cpp', 'matlab_matrix/full.cpp', 'matlab_matrix/sparse.cpp', 'matlab_matrix/symmetric_sparse.cpp', 'group_index.cpp')
+    mex(arraydims,'-Imatlab_matrix', 'group_handler.cpp', 'matlab_matrix/full.cpp', 'matlab_matrix/sparse.cpp', 'matlab_matrix/symmetric_sparse.cpp', 'group_index.cpp', 'gain_kernel.cpp', 'reorder.cpp', 'components.cpp', 'column_cache.cpp', 'arena.cpp', 'directed.cpp', 'aspect_coupling.cpp', 'checkpoint.cpp', 'quality.cpp', 'multilayer.cpp', 'hungarian.cpp')
+    mex(arraydims,'-Imatlab_matrix', 'multilayer_handler.cpp', 'multilayer.cpp', 'hungarian.cpp', 'matlab_matrix/full.cpp', 'matlab_matrix/sparse.cpp', 'matlab_matrix/symmetric_sparse.cpp')
     mex(arraydims,'../Assignment/assignmentoptimal.c')
 end
 
 movefile(['metanetwork_reduce.',ext],['../private/metanetwork_reduce.',ext]);
 movefile(['group_handler.',ext],['../private/group_handler.',ext]);
+movefile(['multilayer_handler.',ext],['../HelperFunctions/private/multilayer_handler.',ext]);
 movefile(['assignmentoptimal.',ext],['../Assignment/assignmentoptimal.',ext]);
@@ -0,0 +1,107 @@
+//
+//  components.cpp
+//  components
+//
+//  Implements the decomposition into components and aggregation of csc matrices.
+//
+//
+// Version: 2.2.0
+
+#include "components.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+csc_matrix::csc_matrix() : n(0), col(1,0) {}
+
+mwSize csc_matrix::max_col_nzero() const {
+    mwSize max_nzero=0;
+    for (mwIndex j=0; j<n; ++j) {
+        max_nzero=max(max_nzero, col[j+1]-col[j]);
+    }
+    return max_nzero;
+}
+
+void csc_matrix::column(mwIndex j, sparse & out) const {
+    mwIndex c=0;
+    for (mwIndex k=col[j]; k<col[j+1]; ++k) {
+        out.row[c]=row[k];
+        out.val[c]=val[k];
+        ++c;
+    }
+    out.m=n;
+    out.n=1;
+    out.col[0]=0;
+    out.col[1]=c;
+}
+
+
+csc_matrix metanetwork(const csc_matrix & B, const vector<mwIndex> & S, mwSize k){
+    //nodes of each group (counting sort)
+    vector<mwIndex> start(k+1,0);
+    for (mwIndex i=0; i<B.n; ++i) {
+        ++start[S[i]+1];
+    }
+    for (mwIndex c=0; c<k; ++c) {
+        start[c+1]+=start[c];
+    }
+    vector<mwIndex> members(B.n);
+    vector<mwIndex> pos(start.begin(), start.end()-1);
+    for (mwIndex i=0; i<B.n; ++i) {
+        members[pos[S[i]]++]=i;
+    }
+
+    //accumulate columns of each group, entries are sorted by row for each column
+    csc_matrix out;
+    out.n=k;
+    out.col.assign(k+1, 0);
+    vector<double> acc(k,0);
+    vector<bool> touched(k,false);
+    vector<mwIndex> rows;
+    for (mwIndex c=0; c<k; ++c) {
+        for (mwIndex m=start[c]; m<start[c+1]; ++m) {
+            mwIndex j=members[m];
+            for (mwIndex e=B.col[j]; e<B.col[j+1]; ++e) {
+                mwIndex r=S[B.row[e]];
+                if (!touched[r]) {
+                    touched[r]=true;
+                    rows.push_back(r);
+                }
+                acc[r]+=B.val[e];
+            }
+        }
+        sort(rows.begin(), rows.end());
+        for (vector<mwIndex>::iterator it=rows.begin(); it!=rows.end(); ++it) {
+            if (acc[*it]!=0) {
+                out.row.push_back(*it);
+                out.val.push_back(acc[*it]);
+            }
+            acc[*it]=0;
+            touched[*it]=false;
+        }
+        rows.clear();
+        out.col[c+1]=out.row.size();
+    }
+    return out;
+}
+
+
+mwIndex component_root(vector<mwIndex> & parent, mwIndex i){
+    while (parent[i]!=i) {
+        parent[i]=parent[parent[i]];
+        i=parent[i];
+    }
+    return i;
+}
+
+
+void positive_neighbours(const sparse & col, mwIndex j, vector<mwIndex> & out){
+    out.clear();
+    for (mwIndex i=0; i<col.nzero(); ++i) {
+        if (col.val[i]>0&&col.row[i]!=j) {
+            out.push_back(col.row[i]);
+        }
+    }
+}
@@ -0,0 +1,184 @@
+//
+//  components.h
+//  components
+//
+//  Structure of the positive part of a modularity matrix (components and graph reduction):
+//
+//      positive_components(B, n_components): component of each node of the graph with an edge
+//              between i and j if B(i,j)>0 (i!=j). Components are numbered in order of their
+//              first node. All entries of B between different components are non-positive, such
+//              that merging groups across components never increases the quality function and
+//              each component can be clustered independently.
+//
+//      fold_nodes(B, twins, n_folded): partition of the nodes into super-nodes for graph reduction.
+//              Nodes with a single positive off-diagonal entry (degree one in the positive part
+//              of B) are merged with their neighbour. With twins, nodes with identical sets of
+//              positive neighbours are also merged. Super-nodes are numbered in order of their
+//              first node.
+//
+//      csc_matrix: compressed sparse column matrix stored in std::vector (does not use the
+//              MATLAB API and can be built and used by worker threads)
+//
+//      submatrix(B, nodes, local, col): B(nodes,nodes) as csc_matrix, where local maps each
+//              node of the component to its position in nodes (entries outside the component
+//              are dropped, col is a column buffer for B)
+//
+//      metanetwork(B, S, k): aggregated matrix P'*B*P for the partition S with k groups
+//              (S(i) in 0,...,k-1)
+//
+//
+// Version: 2.2.0
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+struct csc_matrix{
+    csc_matrix();
+
+    mwSize max_col_nzero() const;
+
+    void column(mwIndex j, sparse & out) const; //copy column j into out (out.nmax needs to be large enough)
+
+    mwSize n;
+    std::vector<mwIndex> col;
+    std::vector<mwIndex> row;
+    std::vector<double> val;
+};
+
+csc_matrix metanetwork(const csc_matrix & B, const std::vector<mwIndex> & S, mwSize k);
+
+//union-find root with path halving
+mwIndex component_root(std::vector<mwIndex> & parent, mwIndex i);
+
+//M is sparse or symmetric_sparse
+template<class M> std::vector<mwIndex> positive_components(const M & B, mwSize & n_components){
+    mwSize n=B.n;
+    sparse col(B.m, 1, B.max_col_nzero());
+    std::vector<mwIndex> parent(n);
+    for (mwIndex i=0; i<n; ++i) {
+        parent[i]=i;
+    }
+    for (mwIndex j=0; j<n; ++j) {
+        B.column(j, col);
+        for (mwIndex i=0; i<col.nzero(); ++i) {
+            if (col.val[i]>0&&col.row[i]!=j) {
+                mwIndex a=component_root(parent, col.row[i]);
+                mwIndex b=component_root(parent, j);
+                if (a!=b) {
+                    parent[a<b ? b : a]=(a<b ? a : b);
+                }
+            }
+        }
+    }
+
+    //number components in order of their first node (roots are the smallest node of each component)
+    std::vector<mwIndex> components(n);
+    n_components=0;
+    for (mwIndex i=0; i<n; ++i) {
+        mwIndex r=component_root(parent, i);
+        components[i]=(r==i) ? n_components++ : components[r];
+    }
+    return components;
+}
+
+//rows of the positive off-diagonal entries of column col of node j (in increasing order)
+void positive_neighbours(const sparse & col, mwIndex j, std::vector<mwIndex> & out);
+
+//M is sparse or symmetric_sparse
+template<class M> std::vector<mwIndex> fold_nodes(const M & B, bool twins, mwSize & n_folded){
+    mwSize n=B.n;
+    sparse col(B.m, 1, B.max_col_nzero());
+    std::vector<mwIndex> parent(n);
+    for (mwIndex i=0; i<n; ++i) {
+        parent[i]=i;
+    }
+    std::vector<mwIndex> neighbours;
+    
+    //pendant nodes, twins are sorted by (degree, hash of neighbours)
+    std::vector<std::pair<std::pair<mwSize, std::uint64_t>, mwIndex> > keys;
+    for (mwIndex j=0; j<n; ++j) {
+        B.column(j, col);
+        positive_neighbours(col, j, neighbours);
+        if (neighbours.size()==1) {
+            mwIndex a=component_root(parent, neighbours[0]);
+            mwIndex b=component_root(parent, j);
+            if (a!=b) {
+                parent[a<b ? b : a]=(a<b ? a : b);
+            }
+        }
+        else if (twins&&neighbours.size()>1) {
+            std::uint64_t hash=14695981039346656037ULL;
+            for (std::vector<mwIndex>::iterator it=neighbours.begin(); it!=neighbours.end(); ++it) {
+                hash=(hash^((std::uint64_t) *it))*1099511628211ULL;
+            }
+            keys.push_back(std::make_pair(std::make_pair((mwSize) neighbours.size(), hash), j));
+        }
+    }
+    
+    if (twins) {
+        std::sort(keys.begin(), keys.end());
+        std::vector<mwIndex> first_neighbours;
+        for (mwIndex k=0; k<keys.size(); ) {
+            //compare all nodes with the same key to the first node (hash collisions are not merged)
+            mwIndex first=keys[k].second;
+            B.column(first, col);
+            positive_neighbours(col, first, first_neighbours);
+            mwIndex l=k+1;
+            for (; l<keys.size()&&keys[l].first==keys[k].first; ++l) {
+                B.column(keys[l].second, col);
+                positive_neighbours(col, keys[l].second, neighbours);
+                if (neighbours==first_neighbours) {
+                    mwIndex a=component_root(parent, first);
+                    mwIndex b=component_root(parent, keys[l].second);
+                    if (a!=b) {
+                        parent[a<b ? b : a]=(a<b ? a : b);
+                    }
+                }
+            }
+            k=l;
+        }
+    }
+    
+    std::vector<mwIndex> folded(n);
+    n_folded=0;
+    for (mwIndex i=0; i<n; ++i) {
+        mwIndex r=component_root(parent, i);
+        folded[i]=(r==i) ? n_folded++ : folded[r];
+    }
+    return folded;
+}
+
+//M is sparse or symmetric_sparse
+template<class M> csc_matrix submatrix(const M & B, const std::vector<mwIndex> & nodes, const std::vector<mwIndex> & local, sparse & col){
+    csc_matrix out;
+    out.n=nodes.size();
+    out.col.assign(out.n+1, 0);
+    for (mwIndex j=0; j<out.n; ++j) {
+        B.column(nodes[j], col);
+        for (mwIndex i=0; i<col.nzero(); ++i) {
+            mwIndex k=local[col.row[i]];
+            if (k<out.n&&nodes[k]==col.row[i]) {
+                out.row.push_back(k);
+                out.val.push_back(col.val[i]);
+            }
+        }
+        out.col[j+1]=out.row.size();
+    }
+    return out;
+}
+
+#endif
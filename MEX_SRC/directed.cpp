@@ -0,0 +1,105 @@
+//
+//  directed.cpp
+//  directed
+//
+//  Implements the directed null model.
+//
+//
+// Version: 2.2.0
+
+#include "directed.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+static bool layer_less(const layer_total & a, mwIndex layer){
+    return a.layer<layer;
+}
+
+void directed_null::assign(const sparse & Rt, const sparse & Ct, const full & w_in, const group_index & g){
+    mwSize n=Rt.n;
+    mwSize T=Rt.m;
+    if (Ct.n!=n||Ct.m!=T||w_in.m*w_in.n!=T||g.n_nodes!=n) {
+        mexErrMsgIdAndTxt("directed:assign", "degree sums, layer weights and partition have incompatible sizes");
+    }
+    w.assign(w_in.val, w_in.val+T);
+
+    //merge the row and column sums of each node (entries are sorted by layer)
+    node_start.assign(n+1, 0);
+    node_layers.clear();
+    for (mwIndex i=0; i<n; ++i) {
+        mwIndex a=Rt.col[i];
+        mwIndex b=Ct.col[i];
+        while (a<Rt.col[i+1]||b<Ct.col[i+1]) {
+            layer_total l;
+            if (b==Ct.col[i+1]||(a<Rt.col[i+1]&&Rt.row[a]<Ct.row[b])) {
+                l.layer=Rt.row[a];
+                l.r=Rt.val[a++];
+                l.c=0;
+            }
+            else if (a==Rt.col[i+1]||Ct.row[b]<Rt.row[a]) {
+                l.layer=Ct.row[b];
+                l.r=0;
+                l.c=Ct.val[b++];
+            }
+            else {
+                l.layer=Rt.row[a];
+                l.r=Rt.val[a++];
+                l.c=Ct.val[b++];
+            }
+            node_layers.push_back(l);
+        }
+        node_start[i+1]=node_layers.size();
+    }
+
+    group_layers.assign(g.n_groups, vector<layer_total>());
+    for (mwIndex i=0; i<n; ++i) {
+        add(i, g.nodes[i], 1);
+    }
+}
+
+double directed_null::interaction(mwIndex node, mwIndex group) const {
+    const vector<layer_total> & totals=group_layers[group];
+    double null=0;
+    for (mwIndex k=node_start[node]; k<node_start[node+1]; ++k) {
+        const layer_total & l=node_layers[k];
+        vector<layer_total>::const_iterator it=lower_bound(totals.begin(), totals.end(), l.layer, layer_less);
+        if (it!=totals.end()&&it->layer==l.layer) {
+            null+=w[l.layer]*(l.c*it->r+l.r*it->c);
+        }
+    }
+    return null;
+}
+
+double directed_null::self(mwIndex node) const {
+    double null=0;
+    for (mwIndex k=node_start[node]; k<node_start[node+1]; ++k) {
+        const layer_total & l=node_layers[k];
+        null+=2*w[l.layer]*l.c*l.r;
+    }
+    return null;
+}
+
+void directed_null::move(mwIndex node, mwIndex from, mwIndex to){
+    add(node, from, -1);
+    add(node, to, 1);
+}
+
+void directed_null::add(mwIndex node, mwIndex group, double sign){
+    vector<layer_total> & totals=group_layers[group];
+    for (mwIndex k=node_start[node]; k<node_start[node+1]; ++k) {
+        const layer_total & l=node_layers[k];
+        vector<layer_total>::iterator it=lower_bound(totals.begin(), totals.end(), l.layer, layer_less);
+        if (it==totals.end()||it->layer!=l.layer) {
+            layer_total t;
+            t.layer=l.layer;
+            t.r=0;
+            t.c=0;
+            it=totals.insert(it, t);
+        }
+        it->r+=sign*l.r;
+        it->c+=sign*l.c;
+    }
+}
@@ -0,0 +1,75 @@
+//
+//  directed.h
+//  directed
+//
+//  Null model of the (symmetrised) Leicht-Newman modularity of a directed (multilayer) network
+//  without forming columns of the modularity matrix:
+//
+//      B(i,j) = A(i,j) - sum_t w(t)*(c(t,i)*r(t,j) + r(t,i)*c(t,j))
+//
+//  where A is the symmetrised adjacency matrix (including interlayer coupling), r(t,i) and
+//  c(t,i) are the row and column sums of node i in layer t and w(t)=gamma(t)/(2*m(t)). For an
+//  aggregated network, the degree sums of a node are the sums over its members, such that the
+//  null model keeps the same form at every level.
+//
+//  The Barber modularity of a bipartite network is the special case where r(t,i) is the degree
+//  of a row-class node and c(t,i) the degree of a column-class node (each node has a single
+//  non-zero sum) and w(t)=gamma(t)/m(t): the group totals are then the row-class and
+//  column-class degree sums and the dense null model blocks between the classes are never formed.
+//
+//      assign(Rt, Ct, w, g): sets the degree sums of each node (Rt and Ct are T x n sparse
+//              matrices, column i holds the sums of node i) and computes the per-layer degree
+//              totals of each group of g
+//
+//      interaction(node, group): null model term between node and all members of group
+//              (including node itself if it is a member)
+//
+//      self(node): null model term of node with itself
+//
+//      move(node, from, to): updates the group totals when node moves between groups, O(number
+//              of layers of node)
+//
+//
+// Version: 2.2.0
+
+#ifndef DIRECTED_H
+#define DIRECTED_H
+
+#include <vector>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+#include "group_index.h"
+
+
+//degree sums of a node or group in a layer
+struct layer_total{
+    mwIndex layer;
+    double r;
+    double c;
+};
+
+struct directed_null{
+    void assign(const sparse & Rt, const sparse & Ct, const full & w, const group_index & g);
+
+    double interaction(mwIndex node, mwIndex group) const;
+
+    double self(mwIndex node) const;
+
+    void move(mwIndex node, mwIndex from, mwIndex to);
+
+    std::vector<double> w;
+    std::vector<mwIndex> node_start; //layers of node i are node_layers[node_start[i]],...,node_layers[node_start[i+1]-1]
+    std::vector<layer_total> node_layers;
+    std::vector<std::vector<layer_total> > group_layers; //sorted by layer
+
+private:
+    void add(mwIndex node, mwIndex group, double sign);
+};
+
+#endif
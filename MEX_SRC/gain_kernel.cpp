@@ -0,0 +1,133 @@
+//
+//  gain_kernel.cpp
+//  gain_kernel
+//
+//  Implements the gather/scatter-add kernels for per-group gain accumulation. Vectorised
+//  versions are only compiled for x86-64 with GCC or Clang and 64-bit indeces
+//  (-largeArrayDims), all other configurations use the scalar kernel.
+//
+//
+// Version: 2.2.0
+
+#include "gain_kernel.h"
+
+#include <cstdint>
+
+#if (defined(__GNUC__)||defined(__clang__))&&defined(__x86_64__)
+    #define GAIN_KERNEL_X86
+    #include <immintrin.h>
+#endif
+
+
+static void scatter_add_scalar(double * gain, const mwIndex * groups, const mwIndex * row, const double * val, mwSize nnz){
+    for (mwIndex i=0; i<nnz; ++i) {
+        gain[groups[row[i]]]+=val[i];
+    }
+}
+
+
+#ifdef GAIN_KERNEL_X86
+
+//gather group ids four at a time, add values in order
+__attribute__((target("avx2")))
+static void scatter_add_avx2(double * gain, const mwIndex * groups, const mwIndex * row, const double * val, mwSize nnz){
+    const long long * g=reinterpret_cast<const long long *>(groups);
+    alignas(32) long long grp[4];
+    mwIndex i=0;
+    for (; i+4<=nnz; i+=4) {
+        __m256i idx=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row+i));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(grp), _mm256_i64gather_epi64(g, idx, 8));
+        gain[grp[0]]+=val[i];
+        gain[grp[1]]+=val[i+1];
+        gain[grp[2]]+=val[i+2];
+        gain[grp[3]]+=val[i+3];
+    }
+    scatter_add_scalar(gain, groups, row+i, val+i, nnz-i);
+}
+
+
+//gather group ids and gains eight at a time. Lanes that share a group are combined first:
+//each lane is linked to the nearest earlier lane with the same group (from the conflict
+//mask) and values are summed along these links by pointer jumping, such that the last lane
+//of each group holds the total and is the only lane that is written back.
+__attribute__((target("avx512f,avx512cd")))
+static void scatter_add_avx512(double * gain, const mwIndex * groups, const mwIndex * row, const double * val, mwSize nnz){
+    const long long * g=reinterpret_cast<const long long *>(groups);
+    const __m512i all_bits=_mm512_set1_epi64(63);
+    mwIndex i=0;
+    for (; i+8<=nnz; i+=8) {
+        __m512i idx=_mm512_loadu_si512(row+i);
+        __m512i grp=_mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, idx, g, 8);
+        __m512d acc=_mm512_loadu_pd(val+i);
+        __m512i conflict=_mm512_conflict_epi64(grp);
+        __mmask8 linked=_mm512_test_epi64_mask(conflict, conflict);
+        __mmask8 last=0xFF;
+        if (linked) {
+            //lanes that are an earlier duplicate of some other lane are not written back
+            alignas(64) long long conflict_bits[8];
+            _mm512_store_si512(conflict_bits, conflict);
+            long long earlier=0;
+            for (int l=0; l<8; ++l) {
+                earlier|=conflict_bits[l];
+            }
+            last=(__mmask8) ~earlier;
+            __m512i link=_mm512_sub_epi64(all_bits, _mm512_lzcnt_epi64(conflict));
+            while (linked) {
+                acc=_mm512_mask_add_pd(acc, linked, acc, _mm512_maskz_permutexvar_pd(0xFF, link, acc));
+                __m512i linked_vec=_mm512_maskz_set1_epi64(linked, -1);
+                __mmask8 next=linked&_mm512_test_epi64_mask(_mm512_maskz_permutexvar_epi64(0xFF, link, linked_vec), linked_vec);
+                link=_mm512_mask_permutexvar_epi64(link, next, link, link);
+                linked=next;
+            }
+        }
+        __m512d old=_mm512_mask_i64gather_pd(_mm512_setzero_pd(), last, grp, gain, 8);
+        _mm512_mask_i64scatter_pd(gain, last, grp, _mm512_add_pd(old, acc), 8);
+    }
+    scatter_add_scalar(gain, groups, row+i, val+i, nnz-i);
+}
+
+#endif
+
+
+typedef void (*scatter_add_kernel)(double *, const mwIndex *, const mwIndex *, const double *, mwSize);
+
+struct kernel_choice {
+    scatter_add_kernel kernel;
+    const char * isa;
+};
+
+//select kernel once based on cpu features
+static kernel_choice select_kernel(){
+#ifdef GAIN_KERNEL_X86
+    if (sizeof(mwIndex)==8) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")&&__builtin_cpu_supports("avx512cd")) {
+            return {scatter_add_avx512, "avx512"};
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return {scatter_add_avx2, "avx2"};
+        }
+    }
+#endif
+    return {scatter_add_scalar, "scalar"};
+}
+
+static const kernel_choice selected=select_kernel();
+
+
+void scatter_add(double * gain, const mwIndex * groups, const mwIndex * row, const double * val, mwSize nnz){
+    selected.kernel(gain, groups, row, val, nnz);
+}
+
+
+//contiguous rows, compiler vectorises the loads
+void scatter_add(double * gain, const mwIndex * groups, const double * val, mwSize m){
+    for (mwIndex i=0; i<m; ++i) {
+        gain[groups[i]]+=val[i];
+    }
+}
+
+
+const char * scatter_add_isa(){
+    return selected.isa;
+}
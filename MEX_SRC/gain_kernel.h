@@ -0,0 +1,38 @@
+//
+//  gain_kernel.h
+//  gain_kernel
+//
+//  Gather/scatter-add kernels that accumulate the column of the modularity matrix for a node
+//  into a dense per-group gain vector:
+//
+//      scatter_add(gain, groups, row, val, nnz): gain[groups[row[i]]]+=val[i] for the non-zero
+//              elements of a sparse column
+//
+//      scatter_add(gain, groups, val, m): gain[groups[i]]+=val[i] for a full column
+//
+//  The sparse kernel is dispatched at runtime to an AVX-512 implementation (using conflict
+//  detection to combine elements that fall into the same group), an AVX2 implementation
+//  (vectorised gather of group ids) or scalar code, depending on the instruction sets
+//  supported by the processor.
+//
+//
+// Version: 2.2.0
+
+#ifndef GAIN_KERNEL_H
+#define GAIN_KERNEL_H
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+
+void scatter_add(double * gain, const mwIndex * groups, const mwIndex * row, const double * val, mwSize nnz);
+
+void scatter_add(double * gain, const mwIndex * groups, const double * val, mwSize m);
+
+//name of the implementation selected for the sparse kernel ("avx512", "avx2" or "scalar")
+const char * scatter_add_isa();
+
+#endif
@@ -8,9 +8,31 @@
 //
 //  [output]=group_handler('function_handle',input)
 //
-//  implemented functions are 'assign', 'move', 'moverand', 'return'
+//  [output]=group_handler('function_handle',engine,input)
+//
+//  implemented functions are 'new', 'delete', 'assign', 'move', 'moverand', 'moverandw', 'moveall',
+//  'moveblock', 'movefn', 'cache', 'movedirected', 'moveaspects', 'movecoupled', 'movelayers',
+//  'components', 'solvecomponents', 'solvetiny', 'propagate', 'aspectnetwork', 'fold', 'issymmetric',
+//  'reorder', 'return', 'quality', 'save', 'load', 'budget', 'truncated'
+//
+//      new:    creates a new engine instance (with its own partition, work space and random
+//              number generator) and returns an opaque handle to it. Functions that use the
+//              engine state take the handle as optional second argument (without handle, a
+//              default instance is used)
+//
+//
+//      delete: takes an engine handle as input and frees the instance
+//
 //
 //      assign: takes a group vector as input and uses it to initialise the "group_index"
+//              (starts a new pass for the pass budget, a group vector with a new number of
+//              nodes starts a new level and resets the arena of the column buffers)
+//
+//              Group vectors, node orders and matrix inputs can be double, single, logical,
+//              int32 or uint32 throughout (group vectors and the partitions passed to 'quality'
+//              need to be full with positive integer labels). Group vectors are read through
+//              typed views, sparse logical matrices borrow their index from matlab and only full
+//              double and sparse double matrices are used without any copy.
 //
 //
 //      move:   takes a node index and the corresponding column of the modularity matrix as
@@ -40,8 +62,224 @@
 //              returns improvement if given an output argument
 //
 //
+//      moveall: takes a move function ('move', 'moverand' or 'moverandw'), a vector with the
+//              order in which to visit nodes and the modularity matrix (sparse or full) as input
+//
+//              moves each node in turn using the corresponding column of the modularity matrix
+//              (avoids a call to group_handler for every node)
+//
+//              an optional fourth argument 'upper' indicates that the modularity matrix is
+//              symmetric and only its upper triangle triu(B) is given as a sparse matrix
+//
+//              an optional fifth argument 'gain' (instead of the default 'column') keeps the
+//              node-to-group sums B*P of a full modularity matrix for the pass (unless they
+//              would need more than 128 MB) and updates them when a node moves, such that the
+//              gains of a move are read from the row of the node instead of being accumulated
+//              from its column. Building the sums costs a pass over B and the candidate groups
+//              are still found from the column, so this only pays off when many nodes move
+//              between few groups (genlouvain option 'gainsums', off by default)
+//
+//              returns the total improvement if given an output argument
+//
+//
+//      moveblock: takes a move function, a vector of node indices idx and the corresponding
+//              block of columns B(:,idx) of the modularity matrix (sparse or full) as input
+//
+//              moves the nodes in idx in turn using column k of the block for node idx(k)
+//              (columns are requested from a function handle in blocks, avoiding a call to
+//              group_handler and to the function handle for every node)
+//
+//              returns the total improvement if given an output argument
+//
+//
+//      movefn: takes a move function, a vector with the order in which to visit nodes and a
+//              function handle that returns the column of the modularity matrix for a node
+//              index as input
+//
+//              moves each node in turn, using the column cache of the engine: columns that are
+//              in the cache are not requested from the function handle again, requested
+//              columns are added to the cache (avoids a call to group_handler for every node
+//              and repeated evaluation of the function handle across passes)
+//
+//              returns the total improvement if given an output argument
+//
+//
+//      cache:  takes the memory limit in bytes of the column cache used by 'movefn' as input and
+//              clears the cache (needs to be called whenever the function handle changes, e.g.
+//              for each new level). Least recently used columns are evicted (CLOCK algorithm)
+//              once the limit is reached. Returns the number of cache hits and misses since
+//              the last call if given an output argument
+//
+//
+//      movedirected: takes a move function, a vector with the order in which to visit nodes, the
+//              symmetrised adjacency matrix A (sparse, including interlayer coupling), the
+//              per-layer row sums Rt and column sums Ct of the directed adjacency matrix of each
+//              node (T x n sparse matrices) and the layer weights w (gamma(t)/(2*m(t))) as input
+//
+//              moves each node in turn for the directed modularity matrix
+//              B(i,j)=A(i,j)-sum_t w(t)*(Ct(t,i)*Rt(t,j)+Rt(t,i)*Ct(t,j)) without forming its
+//              columns: the per-layer degree totals of each group are tracked, such that the
+//              gain of a node costs O(deg) (see directed.h)
+//
+//              returns the total improvement if given an output argument
+//
+//
+//      moveaspects: takes a move function, a vector with the order in which to visit nodes, the
+//              intralayer modularity matrix B of a multiaspect network (sparse, block diagonal
+//              with one block per layer), the number of nodes N, the aspect sizes, the aspect
+//              types (one character per aspect, 'c' or 'm' for categorical, 'o' or 't' for
+//              ordinal) and the coupling strength of each aspect as input (with optional storage
+//              flag 'upper' as for moveall)
+//
+//              moves each node in turn for B+C, where the interlayer coupling C of multiaspect.m
+//              is generated from index arithmetic while assembling each column (see
+//              aspect_coupling.h)
+//
+//              returns the total improvement if given an output argument
+//
+//
+//      movecoupled: takes a move function, a vector with the order in which to visit physical
+//              nodes, the modularity matrix of a multilayer network with T layers of N nodes
+//              (state node i+(t-1)*N is the copy of node i in layer t), the number of layers T
+//              and the coupling type ('ordinal' or 'categorical') as input (with optional
+//              storage flag 'upper' as for moveall)
+//
+//              moves the copies of each physical node jointly: with 'ordinal' coupling, each
+//              maximal run of copies in consecutive layers that are in the same group is moved
+//              as a unit, with 'categorical' coupling all T copies are moved to the same group
+//              (speeds up convergence and avoids poor local optima for strong coupling)
+//
+//              returns the total improvement if given an output argument
+//
+//
+//      movelayers: takes a move function, a vector with the order in which to visit nodes, the
+//              modularity matrix of a multilayer network with T layers of N nodes, the number
+//              of layers T and the number of layers per block as input (with optional storage
+//              flag 'upper' as for moveall and optional number of threads, 0 uses all hardware
+//              threads)
+//
+//              runs local moving until convergence independently on the diagonal block of
+//              the modularity matrix for each block of consecutive layers (in parallel) and
+//              assigns the combined partition. Groups of the current partition that extend
+//              across blocks keep their identity (nodes that are not moved stay in the same
+//              group in all blocks), new groups do not extend across blocks. The result is
+//              meant to be refined by moveall on the full modularity matrix
+//
+//              returns the total improvement of the quality (including the change of the
+//              entries between blocks) if given an output argument
+//
+//
+//      components: takes a sparse modularity matrix (with optional storage flag 'upper' as for
+//              moveall) as input and returns the connected component of each node of the
+//              positive part of the matrix (edges for B(i,j)>0) and the number of components.
+//              Entries between components are non-positive, such that the quality function
+//              is separable across components (from a partition into singletons, Louvain
+//              never merges nodes from different components)
+//
+//
+//      solvecomponents: takes a move function, a sparse modularity matrix, the components
+//              returned by 'components' and a flag for random (true) or index order (false)
+//              of visiting nodes as input (with optional storage flag 'upper' and optional
+//              number of threads, 0 uses all hardware threads)
+//
+//              runs the full multilevel algorithm (local moving and aggregation until no
+//              further improvement) independently for each component in parallel, starting
+//              from singletons. Small components are batched into tasks of at least
+//              component_batch nodes. Assigns the combined partition to the engine and
+//              returns it as for 'return'
+//
+//
+//      solvetiny: takes a move function, the modularity matrix of a small network (at most
+//              tiny_max nodes, sparse or full) and a flag for random (true) or index order
+//              (false) of visiting nodes as input (with optional storage flag 'upper' as for
+//              moveall)
+//
+//              runs all remaining levels (local moving and aggregation until no further
+//              improvement) on a dense copy of the matrix, starting from the assigned
+//              partition. With 'move', a last level with at most tiny_exact nodes is replaced
+//              by its optimal partition (exhaustive search). Assigns the partition to the
+//              engine and returns it as for 'return', and the total improvement as second
+//              output
+//
+//
+//      propagate: takes a modularity matrix (sparse or full) and a maximum number of iterations
+//              as input (with optional storage flag 'upper' as for moveall and optional number
+//              of threads, 0 uses all hardware threads)
+//
+//              runs label propagation on the positive part of the matrix (weighted by the
+//              entries B(i,j)>0), starting from the assigned partition: in each iteration, all
+//              nodes choose the label with the largest total weight among their neighbours (in
+//              parallel) and a random half of them adopts it. For a multilayer network, the
+//              interlayer coupling entries are part of the positive part, such that labels
+//              propagate along the copies of a node. Assigns the partition to the engine and
+//              returns it as for 'return' (used as a cheap initial partition with far fewer
+//              groups than singletons)
+//
+//
+//      aspectnetwork: takes the intralayer modularity matrix, N, aspect sizes, types and coupling
+//              strengths as for moveaspects and a partition S as input (with optional storage
+//              flag 'upper') and returns the aggregated matrix P'*(B+C)*P of S (sparse), without
+//              forming C (does not use the engine)
+//
+//
+//      fold:   takes a sparse modularity matrix and a method ('pendant' or 'all') as input (with
+//              optional storage flag 'upper' as for moveall) and returns a partition R into
+//              super-nodes and the number of super-nodes. With 'pendant', nodes with a single
+//              positive off-diagonal entry are merged with their neighbour, with 'all', nodes
+//              with identical sets of positive neighbours are also merged. The reduced matrix
+//              is the metanetwork of R (exact quality for all partitions that keep super-nodes
+//              together, the reduction itself is a heuristic that only keeps an optimal
+//              partition for 'pendant' and standard modularity with gamma<=1)
+//
+//
+//      issymmetric: takes a modularity matrix (sparse or full) as input and returns true if it
+//              is symmetric (checked without forming the transpose)
+//
+//
+//      reorder: takes a method ('rcm' or 'bfs') and a sparse modularity matrix as input (with
+//              optional storage flag 'upper' as for moveall) and returns a locality improving
+//              permutation p of the nodes (reverse Cuthill-McKee or breadth-first search order
+//              of the sparsity pattern), such that B(p,p) is the reordered matrix
+//
+//              with method 'interleave', takes the number of nodes n and number of layers T
+//              as input and returns the permutation that interleaves the layers of a
+//              multilayer network (copies of the same node in different layers are adjacent)
+//
+//
 //      return: outputs the community assignment for all nodes as a tidy group vector, that is
-//              e.g. S = [1 2 1 3] rather than S = [3 1 3 2]
+//              e.g. S = [1 2 1 3] rather than S = [3 1 3 2] (optional input 'uint32' returns
+//              a uint32 vector instead of double, half the memory for large networks)
+//
+//
+//      quality: takes a modularity matrix (sparse, full or a function handle that returns
+//              columns) and a matrix of partitions (one partition per column) as input
+//
+//              returns the value of the quality function for each partition (computed in a
+//              single pass over the columns of the modularity matrix)
+//
+//              an optional third argument 'upper' indicates that the modularity matrix is
+//              symmetric and only its upper triangle is given as a sparse matrix
+//
+//              for multilayer networks with uniform coupling, takes a cell of intralayer
+//              modularity matrices, a matrix of partitions, the coupling strength omega and
+//              the coupling type ('ordinal' or 'categorical') as input
+//
+//
+//      save:   takes a file name and a scalar struct (with full or sparse double matrices and
+//              char arrays as fields) as input and writes a binary checkpoint containing the
+//              struct and the state of the random number generator of the engine
+//
+//
+//      load:   takes a file name as input, restores the state of the random number generator
+//              of the engine from the checkpoint and returns the stored struct
+//
+//
+//      budget: takes a time limit in seconds and a maximum number of passes as input (inf for
+//              no limit). Once the budget is exhausted, the engine stops at the next node (also
+//              within 'moveall') and skips all further moves, leaving a valid partition
+//
+//
+//      truncated: returns true if the budget was exhausted
 //
 //
 // Version: 2.2.0
@@ -49,13 +287,930 @@
 
 
 #include "group_handler.h"
+#include "quality.h"
+#include "reorder.h"
+#include "instance_registry.h"
+#include "checkpoint.h"
+#include "parallel.h"
+#include "components.h"
+#include "directed.h"
+#include "aspect_coupling.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
 
 using namespace std;
 
-static group_index group;
+static instance_registry<engine> engines;
 //switch on handle
-enum func {ASSIGN, MOVE, MOVERAND, MOVERANDW, RETURN};
-static const unordered_map<string, func> function_switch({ {"assign", ASSIGN}, {"move", MOVE}, {"moverand", MOVERAND}, {"moverandw", MOVERANDW}, {"return", RETURN} });
+enum func {NEW_INSTANCE, DELETE_INSTANCE, ASSIGN, MOVE, MOVERAND, MOVERANDW, MOVEALL, MOVEBLOCK, MOVEFN, CACHE, MOVEDIRECTED, MOVEASPECTS, MOVECOUPLED, MOVELAYERS, COMPONENTS, SOLVECOMPONENTS, SOLVETINY, PROPAGATE, ASPECTNETWORK, FOLD, ISSYMMETRIC, REORDER, RETURN, QUALITY, SAVE, LOAD, BUDGET, TRUNCATED};
+static const unordered_map<string, func> function_switch({ {"new", NEW_INSTANCE}, {"delete", DELETE_INSTANCE}, {"assign", ASSIGN}, {"move", MOVE}, {"moverand", MOVERAND}, {"moverandw", MOVERANDW}, {"moveall", MOVEALL}, {"moveblock", MOVEBLOCK}, {"movefn", MOVEFN}, {"cache", CACHE}, {"movedirected", MOVEDIRECTED}, {"moveaspects", MOVEASPECTS}, {"movecoupled", MOVECOUPLED}, {"movelayers", MOVELAYERS}, {"components", COMPONENTS}, {"solvecomponents", SOLVECOMPONENTS}, {"solvetiny", SOLVETINY}, {"propagate", PROPAGATE}, {"aspectnetwork", ASPECTNETWORK}, {"fold", FOLD}, {"issymmetric", ISSYMMETRIC}, {"reorder", REORDER}, {"return", RETURN}, {"quality", QUALITY}, {"save", SAVE}, {"load", LOAD}, {"budget", BUDGET}, {"truncated", TRUNCATED} });
+
+//check for 'upper' storage flag
+static bool upper_storage(const mxArray * flag){
+    mwSize strleng = mxGetM(flag)*mxGetN(flag)+1;
+    char * storage=(char *) mxCalloc(strleng, sizeof(char));
+    if (mxGetString(flag, storage, strleng)||(strcmp(storage, "upper")&&strcmp(storage, "full"))) {
+        mexErrMsgIdAndTxt("group_handler:storage", "storage needs to be 'full' or 'upper'");
+    }
+    bool upper=!strcmp(storage, "upper");
+    mxFree(storage);
+    return upper;
+}
+
+//kernel of moveall for a full matrix ('column' or 'gain'), true for 'gain'
+static bool gain_kernel_arg(const mxArray * flag){
+    mwSize strleng = mxGetM(flag)*mxGetN(flag)+1;
+    char * kernel=(char *) mxCalloc(strleng, sizeof(char));
+    if (mxGetString(flag, kernel, strleng)||(strcmp(kernel, "column")&&strcmp(kernel, "gain"))) {
+        mexErrMsgIdAndTxt("group_handler:kernel", "kernel needs to be 'column' or 'gain'");
+    }
+    bool gain=!strcmp(kernel, "gain");
+    mxFree(kernel);
+    return gain;
+}
+
+//class of a returned partition ('double' or 'uint32'), true for 'uint32'
+static bool uint32_output(const mxArray * flag){
+    mwSize strleng = mxGetM(flag)*mxGetN(flag)+1;
+    char * type=(char *) mxCalloc(strleng, sizeof(char));
+    if (mxGetString(flag, type, strleng)||(strcmp(type, "double")&&strcmp(type, "uint32"))) {
+        mexErrMsgIdAndTxt("group_handler:return", "output class needs to be 'double' or 'uint32'");
+    }
+    bool uint32=!strcmp(type, "uint32");
+    mxFree(type);
+    return uint32;
+}
+
+//minimum number of nodes per task for solvecomponents
+static const mwSize component_batch=4096;
+
+//read move function ('move', 'moverand' or 'moverandw') from matlab string
+static func move_function_arg(const mxArray * name, const char * id){
+    mwSize strleng = mxGetM(name)*mxGetN(name)+1;
+    char * move_name=(char *) mxCalloc(strleng, sizeof(char));
+    if (mxGetString(name, move_name, strleng)||!function_switch.count(move_name)) {
+        mexErrMsgIdAndTxt(id, "move function needs to be 'move', 'moverand' or 'moverandw'");
+    }
+    func move_function=function_switch.at(move_name);
+    mxFree(move_name);
+    if (move_function!=MOVE&&move_function!=MOVERAND&&move_function!=MOVERANDW) {
+        mexErrMsgIdAndTxt(id, "move function needs to be 'move', 'moverand' or 'moverandw'");
+    }
+    return move_function;
+}
+
+//choose one of the improving moves according to the move function
+static mwIndex choose_move(engine & e, func move_function, const move_list & moves){
+    switch (move_function) {
+        case MOVERAND: {
+            std::uniform_int_distribution<mwIndex> randindex(0,moves.first.size()-1);
+            return randindex(e.generator);
+        }
+        case MOVERANDW: {
+            std::discrete_distribution<mwIndex> randindex(moves.second.begin(),moves.second.end());
+            return randindex(e.generator);
+        }
+        default: {
+            mwIndex best=0;
+            for (mwIndex i=1; i<moves.second.size(); ++i) {
+                if (moves.second[i]>moves.second[best]) {
+                    best=i;
+                }
+            }
+            return best;
+        }
+    }
+}
+
+//move the copies of each physical node in order jointly (runs of copies in consecutive layers in
+//the same group for ordinal coupling, all copies for categorical coupling)
+template<class M, class C> double movecoupled(engine & e, func move_function, const full & order, mwSize T, bool categorical, const M & mod, C & col){
+    group_index & group=e.group;
+    mwSize N=group.n_nodes/T;
+    double dstep=0;
+    for (mwIndex i=0; i<order.m*order.n; ++i) {
+        mwIndex node=((mwIndex) order.get(i))-1;
+        if (!(node<N)) {
+            mexErrMsgIdAndTxt("group_handler:movecoupled", "node index out of bounds");
+        }
+        mwIndex first=0;
+        while (first<T) {
+            if (e.budget.expired()) {
+                return dstep;
+            }
+            mwIndex last=T-1;
+            if (!categorical) {
+                last=first;
+                while (last+1<T&&group.nodes[node+(last+1)*N]==group.nodes[node+first*N]) {
+                    ++last;
+                }
+            }
+            state_run run(node, N, first, last);
+            move_list moves=coupled_moves(e, run, mod, col);
+            if (!moves.first.empty()) {
+                mwIndex choice=choose_move(e, move_function, moves);
+                for (mwIndex t=first; t<=last; ++t) {
+                    group.move(node+t*N, moves.first[choice]);
+                }
+                dstep+=moves.second[choice];
+            }
+            first=last+1;
+        }
+    }
+    return dstep;
+}
+
+//move node using column col of the modularity matrix (move_function is checked by move_function_arg)
+template<class C> double apply_move(engine & e, func move_function, mwIndex node, const C & col){
+    switch (move_function) {
+        case MOVERAND:
+            return moverand(e, node, col);
+        case MOVERANDW:
+            return moverandw(e, node, col);
+        default:
+            return move(e, node, col);
+    }
+}
+
+//move each node in order, copying the corresponding column of mod into the column buffer col
+template<class M, class C> double moveall(engine & e, func move_function, const full & order, const M & mod, C & col){
+    group_index & group=e.group;
+    double dstep=0;
+    for (mwIndex i=0; i<order.m*order.n; ++i) {
+        mwIndex node=((mwIndex) order.get(i))-1;
+        if (!(node<group.n_nodes)) {
+            mexErrMsgIdAndTxt("group_handler:moveall", "node index out of bounds");
+        }
+        if (e.budget.expired()) {
+            break;
+        }
+        mod.column(node, col);
+        dstep+=apply_move(e, move_function, node, col);
+    }
+    return dstep;
+}
+
+//largest node-to-group matrix (number of entries) used by moveall for a full modularity matrix
+static const mwSize dense_gain_max=((mwSize) 1)<<24;
+
+//move each node in order using the rows of the node-to-group matrix of the full matrix mod
+static double moveall_gain(engine & e, func move_function, const full & order, const full & mod){
+    group_index & group=e.group;
+    dense_gain & gain=e.gain;
+    gain.build(group, mod);
+    double dstep=0;
+    for (mwIndex i=0; i<order.m*order.n; ++i) {
+        mwIndex node=((mwIndex) order.get(i))-1;
+        if (!(node<group.n_nodes)) {
+            mexErrMsgIdAndTxt("group_handler:moveall", "node index out of bounds");
+        }
+        if (e.budget.expired()) {
+            break;
+        }
+        mwIndex from=group.nodes[node];
+        dstep+=apply_move(e, move_function, node, gain.row(mod, node));
+        if (group.nodes[node]!=from) {
+            gain.update(mod, node, from, group.nodes[node]);
+        }
+    }
+    gain.release();
+    return dstep;
+}
+
+//move each node in order for the directed modularity given by the symmetrised adjacency matrix
+//A and the null model null (candidate groups are the groups of the neighbours of a node in A)
+static double movedirected(engine & e, func move_function, const full & order, const sparse & A, directed_null & null, sparse & col){
+    group_index & group=e.group;
+    move_workspace & w=e.workspace;
+    double dstep=0;
+    move_list moves;
+    for (mwIndex i=0; i<order.m*order.n; ++i) {
+        mwIndex node=((mwIndex) order.get(i))-1;
+        if (!(node<group.n_nodes)) {
+            mexErrMsgIdAndTxt("group_handler:movedirected", "node index out of bounds");
+        }
+        if (e.budget.expired()) {
+            break;
+        }
+        A.column(node, col);
+        set_type & unique_groups=possible_moves(group, w, node, col);
+        map_type & mod_c=mod_change(group, w, col, unique_groups, node);
+        
+        //correct the adjacency gains by the null model (relative to the current group without node)
+        mwIndex current_group=group.nodes[node];
+        double current=null.interaction(node, current_group)-null.self(node);
+        moves.first.clear();
+        moves.second.clear();
+        for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
+            if (*it!=current_group) {
+                double gain=mod_c[*it]-null.interaction(node, *it)+current;
+                if (gain>NUM_TOL) {
+                    moves.first.push_back(*it);
+                    moves.second.push_back(gain);
+                }
+            }
+        }
+        w.clear(group, col);
+        
+        if (!moves.first.empty()) {
+            mwIndex k=choose_move(e, move_function, moves);
+            group.move(node, moves.first[k]);
+            null.move(node, current_group, moves.first[k]);
+            dstep+=moves.second[k];
+        }
+    }
+    return dstep;
+}
+
+//move node nodes(k) using column k of mod for each k in turn
+template<class M, class C> double moveblock(engine & e, func move_function, const full & nodes, const M & mod, C & col){
+    group_index & group=e.group;
+    double dstep=0;
+    for (mwIndex k=0; k<nodes.m*nodes.n; ++k) {
+        mwIndex node=((mwIndex) nodes.get(k))-1;
+        if (!(node<group.n_nodes)) {
+            mexErrMsgIdAndTxt("group_handler:moveblock", "node index out of bounds");
+        }
+        if (e.budget.expired()) {
+            break;
+        }
+        mod.column(k, col);
+        dstep+=apply_move(e, move_function, node, col);
+    }
+    return dstep;
+}
+
+//move each node in order, taking columns from the column cache of the engine or requesting them
+//from the function handle fn (the column buffer cached needs nmax of at least group.n_nodes)
+static double movefn(engine & e, func move_function, const full & order, const mxArray * fn, sparse & cached){
+    group_index & group=e.group;
+    if (e.cache.n!=group.n_nodes) {
+        e.cache.reset(group.n_nodes, e.cache.max_bytes);
+    }
+    double dstep=0;
+    mxArray * args[2];
+    args[0]=const_cast<mxArray *>(fn);
+    args[1]=mxCreateDoubleScalar(0);
+    for (mwIndex i=0; i<order.m*order.n; ++i) {
+        mwIndex node=((mwIndex) order.get(i))-1;
+        if (!(node<group.n_nodes)) {
+            mexErrMsgIdAndTxt("group_handler:movefn", "node index out of bounds");
+        }
+        if (e.budget.expired()) {
+            break;
+        }
+        if (e.cache.get(node, cached)) {
+            dstep+=apply_move(e, move_function, node, cached);
+            continue;
+        }
+        
+        //request column
+        mxArray * col;
+        *mxGetPr(args[1])=node+1;
+        mexCallMATLAB(1, &col, 2, args, "feval");
+        if (mxGetM(col)!=group.n_nodes||mxGetN(col)!=1||!is_numeric_input(col)) {
+            mexErrMsgIdAndTxt("group_handler:movefn", "function handle needs to return a real (double, single or logical) column of the modularity matrix");
+        }
+        if (mxIsSparse(col)) {
+            sparse mod(col);
+            e.cache.insert(node, mod);
+            dstep+=apply_move(e, move_function, node, mod);
+        }
+        else {
+            full mod(col);
+            e.cache.insert(node, mod);
+            dstep+=apply_move(e, move_function, node, mod);
+        }
+        mxDestroyArray(col);
+    }
+    mxDestroyArray(args[1]);
+    return dstep;
+}
+
+//restrict column col to the rows begin,...,end-1 (out needs to be large enough)
+static void block_column(const sparse & col, mwIndex begin, mwIndex end, sparse & out){
+    mwIndex k=0;
+    for (mwIndex i=0; i<col.nzero(); ++i) {
+        if (col.row[i]>=begin&&col.row[i]<end) {
+            out.row[k]=col.row[i]-begin;
+            out.val[k]=col.val[i];
+            ++k;
+        }
+    }
+    out.col[0]=0;
+    out.col[1]=k;
+}
+
+static void block_column(const full & col, mwIndex begin, mwIndex end, full & out){
+    for (mwIndex i=begin; i<end; ++i) {
+        out.get(i-begin)=col.get(i);
+    }
+}
+
+//change in the entries of column col of node between blocks of block_size nodes when the
+//partition changes from before to after (each entry is counted from both sides)
+static double cross_block_change(const full & col, mwIndex node, mwSize block_size, const std::vector<mwIndex> & before, const std::vector<mwIndex> & after){
+    double change=0;
+    for (mwIndex i=0; i<col.m; ++i) {
+        if (i/block_size!=node/block_size) {
+            change+=col.get(i)*((after[i]==after[node])-(before[i]==before[node]));
+        }
+    }
+    return change/2;
+}
+
+static double cross_block_change(const sparse & col, mwIndex node, mwSize block_size, const std::vector<mwIndex> & before, const std::vector<mwIndex> & after){
+    double change=0;
+    for (mwIndex i=0; i<col.nzero(); ++i) {
+        mwIndex j=col.row[i];
+        if (j/block_size!=node/block_size) {
+            change+=col.val[i]*((after[j]==after[node])-(before[j]==before[node]));
+        }
+    }
+    return change/2;
+}
+
+//local moving on the diagonal blocks of mod for blocks of block_layers consecutive layers, solved
+//in parallel with one engine per block (seeded from the generator of e and sharing its budget).
+//col and block_col hold one column buffer per thread (allocated by the caller, as the MATLAB API
+//cannot be used by the worker threads)
+template<class M, class C> double movelayers(engine & e, func move_function, const full & order, mwSize T, mwSize block_layers, const M & mod, std::vector<C> & col, std::vector<C> & block_col){
+    group_index & group=e.group;
+    mwSize N=group.n_nodes/T;
+    mwSize block_size=block_layers*N;
+    mwSize n_blocks=(T+block_layers-1)/block_layers;
+    
+    //visiting order within each block
+    std::vector<std::vector<mwIndex> > block_order(n_blocks);
+    for (mwIndex i=0; i<order.m*order.n; ++i) {
+        mwIndex node=((mwIndex) order.get(i))-1;
+        if (!(node<group.n_nodes)) {
+            mexErrMsgIdAndTxt("group_handler:movelayers", "node index out of bounds");
+        }
+        block_order[node/block_size].push_back(node);
+    }
+    std::vector<std::default_random_engine::result_type> seeds(n_blocks);
+    for (mwIndex k=0; k<n_blocks; ++k) {
+        seeds[k]=e.generator();
+    }
+    
+    //groups of the current partition that extend across blocks
+    bool spanning=false;
+    std::vector<mwIndex> first_block(group.n_groups, n_blocks);
+    for (mwIndex i=0; i<group.n_nodes; ++i) {
+        mwIndex & b=first_block[group.nodes[i]];
+        if (b==n_blocks) {
+            b=i/block_size;
+        }
+        else if (b!=i/block_size) {
+            spanning=true;
+        }
+    }
+    
+    //groups are relabelled within each block and mapped back to the current groups afterwards
+    //(groups created within block k get labels from group.n_groups+k*block_size)
+    std::vector<mwIndex> partition(group.n_nodes);
+    std::vector<double> dsteps(n_blocks,0);
+    std::vector<char> truncated(n_blocks,false);
+    parallel_for(n_blocks, (unsigned) col.size(), [&](mwIndex k, unsigned t){
+        mwIndex begin=k*block_size;
+        mwIndex end=std::min(begin+block_size, group.n_nodes);
+        engine local;
+        local.generator.seed(seeds[k]);
+        local.budget=e.budget;
+        
+        //groups of the current partition restricted to the block
+        std::unordered_map<mwIndex, mwIndex> labels;
+        std::vector<mwIndex> global_labels;
+        std::vector<mwIndex> local_nodes(end-begin);
+        for (mwIndex i=begin; i<end; ++i) {
+            std::pair<std::unordered_map<mwIndex, mwIndex>::iterator, bool> label=labels.insert(std::make_pair(group.nodes[i], (mwIndex) labels.size()));
+            if (label.second) {
+                global_labels.push_back(group.nodes[i]);
+            }
+            local_nodes[i-begin]=label.first->second;
+        }
+        local.group=local_nodes;
+        
+        double dtot=0;
+        double dstep;
+        do {
+            dstep=0;
+            for (std::vector<mwIndex>::iterator it=block_order[k].begin(); it!=block_order[k].end(); ++it) {
+                mod.column(*it, col[t]);
+                block_column(col[t], begin, end, block_col[t]);
+                dstep+=apply_move(local, move_function, *it-begin, block_col[t]);
+            }
+            dtot+=dstep;
+        } while (dstep>10*std::numeric_limits<double>::epsilon()&&dstep>2*std::numeric_limits<double>::epsilon()*dtot&&!local.budget.expired());
+        
+        for (mwIndex i=begin; i<end; ++i) {
+            mwIndex l=local.group.nodes[i-begin];
+            partition[i]=(l<global_labels.size()) ? global_labels[l] : group.n_groups+begin+l;
+        }
+        dsteps[k]=dtot;
+        truncated[k]=local.budget.truncated;
+    });
+    
+    double dstep=0;
+    for (mwIndex k=0; k<n_blocks; ++k) {
+        dstep+=dsteps[k];
+        if (truncated[k]) {
+            e.budget.truncated=true;
+        }
+    }
+    //the blocks only see their diagonal block, add the change in the entries between blocks
+    //(none if no group extends across blocks, as new groups stay within their block)
+    if (spanning) {
+        for (mwIndex i=0; i<group.n_nodes; ++i) {
+            mod.column(i, col[0]);
+            dstep+=cross_block_change(col[0], i, block_size, group.nodes, partition);
+        }
+    }
+    
+    //relabel groups consecutively
+    std::vector<mwIndex> relabel(group.n_groups+group.n_nodes, group.n_nodes);
+    mwIndex n_groups=0;
+    for (mwIndex i=0; i<group.n_nodes; ++i) {
+        mwIndex & label=relabel[partition[i]];
+        if (label==group.n_nodes) {
+            label=n_groups++;
+        }
+        partition[i]=label;
+    }
+    group=partition;
+    return dstep;
+}
+
+//multilevel algorithm for a single component starting from singletons (local moving until no
+//improvement, then aggregation, until no further aggregation is possible or the budget is
+//exhausted), col is a column buffer with at least B.n rows and non-zeros
+static vector<mwIndex> solve_component(engine & e, func move_function, bool random_order, csc_matrix B, sparse & col){
+    vector<mwIndex> S(B.n);
+    for (mwIndex i=0; i<B.n; ++i) {
+        S[i]=i;
+    }
+    vector<mwIndex> order;
+    while (true) {
+        vector<mwIndex> y(B.n);
+        order.resize(B.n);
+        for (mwIndex i=0; i<B.n; ++i) {
+            y[i]=i;
+            order[i]=i;
+        }
+        e.group=y;
+        double dtot=0;
+        double dstep;
+        do {
+            if (random_order) {
+                std::shuffle(order.begin(), order.end(), e.generator);
+            }
+            dstep=0;
+            for (vector<mwIndex>::iterator it=order.begin(); it!=order.end(); ++it) {
+                B.column(*it, col);
+                dstep+=apply_move(e, move_function, *it, col);
+            }
+            dtot+=dstep;
+        } while (dstep>10*std::numeric_limits<double>::epsilon()&&dstep>2*std::numeric_limits<double>::epsilon()*dtot&&!e.budget.expired());
+        
+        //tidy group labels (in order of first node)
+        vector<mwIndex> label(B.n, B.n);
+        mwSize k=0;
+        for (mwIndex i=0; i<B.n; ++i) {
+            mwIndex g=e.group.nodes[i];
+            if (label[g]==B.n) {
+                label[g]=k++;
+            }
+            y[i]=label[g];
+        }
+        for (mwIndex i=0; i<S.size(); ++i) {
+            S[i]=y[S[i]];
+        }
+        if (k==B.n||e.budget.expired()) {
+            return S;
+        }
+        B=metanetwork(B, y, k);
+    }
+}
+
+//nodes per task of label propagation
+static const mwSize propagate_batch=1024;
+
+//label with the largest accumulated weight in acc (only the entries in touched are non-zero and
+//are reset). Keeps the current label if it is one of the best labels, otherwise ties are broken
+//in favour of the smallest label.
+static mwIndex choose_label(mwIndex current, vector<double> & acc, vector<mwIndex> & touched){
+    mwIndex best=current;
+    double best_weight=acc[current];
+    for (vector<mwIndex>::iterator it=touched.begin(); it!=touched.end(); ++it) {
+        if (*it!=current&&(acc[*it]>best_weight||(acc[*it]==best_weight&&best!=current&&*it<best))) {
+            best=*it;
+            best_weight=acc[*it];
+        }
+    }
+    for (vector<mwIndex>::iterator it=touched.begin(); it!=touched.end(); ++it) {
+        acc[*it]=0;
+    }
+    touched.clear();
+    return best;
+}
+
+//label with the largest total positive weight among the neighbours of node (col is the column
+//of node, the current label is kept if node has no positive neighbours)
+static mwIndex best_label(const sparse & col, mwIndex node, const vector<mwIndex> & lab, vector<double> & acc, vector<mwIndex> & touched){
+    for (mwIndex i=0; i<col.nzero(); ++i) {
+        if (col.val[i]>0&&col.row[i]!=node) {
+            mwIndex l=lab[col.row[i]];
+            if (acc[l]==0) {
+                touched.push_back(l);
+            }
+            acc[l]+=col.val[i];
+        }
+    }
+    return choose_label(lab[node], acc, touched);
+}
+
+static mwIndex best_label(const full & col, mwIndex node, const vector<mwIndex> & lab, vector<double> & acc, vector<mwIndex> & touched){
+    for (mwIndex i=0; i<col.m; ++i) {
+        if (col.get(i)>0&&i!=node) {
+            mwIndex l=lab[i];
+            if (acc[l]==0) {
+                touched.push_back(l);
+            }
+            acc[l]+=col.get(i);
+        }
+    }
+    return choose_label(lab[node], acc, touched);
+}
+
+//pseudo-random bit for node in an iteration with the given seed (splitmix64 finaliser)
+static bool update_bit(std::uint64_t seed, mwIndex node){
+    std::uint64_t h=seed^(((std::uint64_t) node+1)*0x9E3779B97F4A7C15ULL);
+    h=(h^(h>>30))*0xBF58476D1CE4E5B9ULL;
+    h=(h^(h>>27))*0x94D049BB133111EBULL;
+    return ((h^(h>>31))&1)!=0;
+}
+
+//label propagation on the positive part of mod, starting from the partition of the engine. In
+//each iteration, all nodes choose their best label from the labels of the previous iteration
+//(in parallel, batches of consecutive nodes), and a random half of them adopts it (avoids the
+//oscillations of fully synchronous updates). Stops after max_iter iterations or once no node
+//prefers another label. col holds one column buffer per thread.
+template<class M, class C> vector<mwIndex> propagate_labels(engine & e, const M & mod, mwSize max_iter, unsigned n_threads, vector<C> & col){
+    mwSize n=mod.n;
+    vector<mwIndex> lab(e.group.nodes.begin(), e.group.nodes.end());
+    vector<mwIndex> next(lab);
+    vector<vector<double> > acc(n_threads, vector<double>(e.group.n_groups, 0));
+    vector<vector<mwIndex> > touched(n_threads);
+    vector<mwSize> unstable(n_threads);
+    mwSize n_tasks=(n+propagate_batch-1)/propagate_batch;
+    for (mwIndex it=0; it<max_iter&&!e.budget.expired(); ++it) {
+        std::uint64_t seed=(((std::uint64_t) e.generator())<<32)^e.generator();
+        unstable.assign(n_threads, 0);
+        parallel_for(n_tasks, n_threads, [&](mwIndex task, unsigned t){
+            mwIndex end=std::min(n, (task+1)*propagate_batch);
+            for (mwIndex node=task*propagate_batch; node<end; ++node) {
+                mod.column(node, col[t]);
+                mwIndex l=best_label(col[t], node, lab, acc[t], touched[t]);
+                if (l!=lab[node]) {
+                    ++unstable[t];
+                    if (update_bit(seed, node)) {
+                        next[node]=l;
+                    }
+                }
+            }
+        });
+        std::copy(next.begin(), next.end(), lab.begin());
+        mwSize n_unstable=0;
+        for (unsigned t=0; t<n_threads; ++t) {
+            n_unstable+=unstable[t];
+        }
+        if (n_unstable==0) {
+            break;
+        }
+    }
+    return lab;
+}
+
+//largest network handled by solvetiny and largest level that is searched exhaustively
+static const mwSize tiny_max=4096;
+static const mwSize tiny_exact=10;
+
+//dense column-major copy of a modularity matrix
+static void dense_copy(const full & mod, vector<double> & A){
+    A.assign(mod.val, mod.val+mod.m*mod.n);
+}
+
+template<class M> void dense_copy(const M & mod, vector<double> & A){
+    A.assign(mod.m*mod.n, 0);
+    sparse col(mod.m, 1, mod.max_col_nzero());
+    for (mwIndex j=0; j<mod.n; ++j) {
+        mod.column(j, col);
+        for (mwIndex i=0; i<col.nzero(); ++i) {
+            A[col.row[i]+j*mod.m]=col.val[i];
+        }
+    }
+}
+
+//enumerate all partitions of the m nodes of A as restricted growth strings (node i joins one of
+//the groups 0,...,n_groups-1 of nodes 0,...,i-1 or opens group n_groups), q is the quality of
+//the partition of nodes 0,...,i-1
+static void exhaustive_partition(const double * A, mwSize m, mwIndex i, mwSize n_groups, double q, mwIndex * a, double & best_q, mwIndex * best){
+    if (i==m) {
+        if (q>best_q) {
+            best_q=q;
+            std::copy(a, a+m, best);
+        }
+        return;
+    }
+    for (mwIndex c=0; c<=n_groups; ++c) {
+        double dq=A[i+i*m];
+        for (mwIndex j=0; j<i; ++j) {
+            if (a[j]==c) {
+                dq+=A[i+j*m]+A[j+i*m];
+            }
+        }
+        a[i]=c;
+        exhaustive_partition(A, m, i+1, c==n_groups ? n_groups+1 : n_groups, q+dq, a, best_q, best);
+    }
+}
+
+//multilevel solver for tiny networks (local moving and aggregation on a dense matrix until no
+//further improvement) starting from the partition of the engine. With move_function 'move', the
+//last level is improved to the optimal partition if it has at most tiny_exact nodes. Returns the
+//partition of the nodes of A (m x m, column major) and adds the improvement to dtot
+static vector<mwIndex> solve_tiny(engine & e, func move_function, bool random_order, vector<double> A, mwSize m, double & dtot){
+    vector<mwIndex> S(m); //node of the current level of each node
+    vector<mwIndex> lab(e.group.nodes.begin(), e.group.nodes.end());
+    mwSize n_labels=e.group.n_groups;
+    for (mwIndex i=0; i<m; ++i) {
+        S[i]=i;
+    }
+    vector<mwIndex> order;
+    vector<double> gain;
+    vector<mwSize> count;
+    move_list moves;
+    while (true) {
+        count.assign(n_labels, 0);
+        for (mwIndex i=0; i<m; ++i) {
+            ++count[lab[i]];
+        }
+        order.resize(m);
+        for (mwIndex i=0; i<m; ++i) {
+            order[i]=i;
+        }
+        
+        //local moving (all improving moves to non-empty groups are considered)
+        double dlevel=0;
+        double dstep;
+        do {
+            if (random_order) {
+                std::shuffle(order.begin(), order.end(), e.generator);
+            }
+            dstep=0;
+            for (vector<mwIndex>::iterator it=order.begin(); it!=order.end(); ++it) {
+                if (e.budget.expired()) {
+                    break;
+                }
+                mwIndex v=*it;
+                const double * col=A.data()+v*m;
+                gain.assign(n_labels, 0);
+                for (mwIndex j=0; j<m; ++j) {
+                    gain[lab[j]]+=col[j];
+                }
+                mwIndex current_group=lab[v];
+                double current=gain[current_group]-col[v];
+                moves.first.clear();
+                moves.second.clear();
+                for (mwIndex c=0; c<n_labels; ++c) {
+                    if (c!=current_group&&count[c]>0&&gain[c]-current>NUM_TOL) {
+                        moves.first.push_back(c);
+                        moves.second.push_back(gain[c]-current);
+                    }
+                }
+                if (!moves.first.empty()) {
+                    mwIndex k=choose_move(e, move_function, moves);
+                    --count[current_group];
+                    ++count[moves.first[k]];
+                    lab[v]=moves.first[k];
+                    dstep+=moves.second[k];
+                }
+            }
+            dlevel+=dstep;
+        } while (dstep>10*std::numeric_limits<double>::epsilon()&&dstep>2*std::numeric_limits<double>::epsilon()*dlevel&&!e.budget.expired());
+        dtot+=dlevel;
+        
+        //tidy group labels (in order of first node)
+        vector<mwIndex> label(n_labels, n_labels);
+        mwSize k=0;
+        for (mwIndex i=0; i<m; ++i) {
+            if (label[lab[i]]==n_labels) {
+                label[lab[i]]=k++;
+            }
+            lab[i]=label[lab[i]];
+        }
+        for (mwIndex i=0; i<S.size(); ++i) {
+            S[i]=lab[S[i]];
+        }
+        if (k==m||e.budget.expired()) {
+            break;
+        }
+        
+        //aggregate
+        vector<double> A_k(k*k, 0);
+        for (mwIndex j=0; j<m; ++j) {
+            for (mwIndex i=0; i<m; ++i) {
+                A_k[lab[i]+lab[j]*k]+=A[i+j*m];
+            }
+        }
+        A.swap(A_k);
+        m=k;
+        n_labels=k;
+        for (mwIndex i=0; i<m; ++i) {
+            lab[i]=i;
+        }
+        lab.resize(m);
+    }
+    
+    //optimal partition of a very small last level (all nodes are singletons at this point)
+    if (move_function==MOVE&&m>1&&m<=tiny_exact&&!e.budget.expired()) {
+        mwIndex a[tiny_exact];
+        mwIndex best[tiny_exact];
+        double q0=0;
+        for (mwIndex i=0; i<m; ++i) {
+            q0+=A[i+i*m];
+            best[i]=i;
+        }
+        double best_q=q0;
+        exhaustive_partition(A.data(), m, 0, 0, 0, a, best_q, best);
+        if (best_q-q0>NUM_TOL) {
+            for (mwIndex i=0; i<S.size(); ++i) {
+                S[i]=best[S[i]];
+            }
+            dtot+=(best_q-q0)/2;
+        }
+    }
+    return S;
+}
+
+//solve each component independently (in parallel), components[i] is the component of node i.
+//Returns the combined partition (groups are numbered consecutively by component)
+template<class M> vector<mwIndex> solvecomponents(engine & e, func move_function, bool random_order, const M & mod, const vector<mwIndex> & components, unsigned n_threads){
+    mwSize n=mod.n;
+    mwSize n_components=0;
+    for (mwIndex i=0; i<n; ++i) {
+        if (!(components[i]<n)) {
+            mexErrMsgIdAndTxt("group_handler:solvecomponents", "invalid component index");
+        }
+        n_components=max(n_components, components[i]+1);
+    }
+    
+    //nodes of each component and position of each node in its component
+    vector<vector<mwIndex> > nodes(n_components);
+    vector<mwIndex> local(n);
+    for (mwIndex i=0; i<n; ++i) {
+        local[i]=nodes[components[i]].size();
+        nodes[components[i]].push_back(i);
+    }
+    
+    //batch small components into tasks
+    vector<mwIndex> task_start(1,0);
+    mwSize task_size=0;
+    mwSize max_size=0;
+    for (mwIndex c=0; c<n_components; ++c) {
+        task_size+=nodes[c].size();
+        max_size=max(max_size, (mwSize) nodes[c].size());
+        if (task_size>=component_batch||c+1==n_components) {
+            task_start.push_back(c+1);
+            task_size=0;
+        }
+    }
+    mwSize n_tasks=task_start.size()-1;
+    n_threads=thread_count(n_threads, n_tasks);
+    vector<std::default_random_engine::result_type> seeds(n_tasks);
+    for (mwIndex k=0; k<n_tasks; ++k) {
+        seeds[k]=e.generator();
+    }
+    
+    //column buffers for each thread (the MATLAB API cannot be used by the worker threads)
+    vector<sparse> col=arena_sparse_columns(e.scratch, n_threads, mod.m, mod.max_col_nzero());
+    vector<sparse> component_col=arena_sparse_columns(e.scratch, n_threads, max_size, max_size);
+    
+    vector<vector<mwIndex> > partitions(n_components);
+    vector<char> truncated(n_tasks,false);
+    parallel_for(n_tasks, n_threads, [&](mwIndex k, unsigned t){
+        engine local_engine;
+        local_engine.generator.seed(seeds[k]);
+        local_engine.budget=e.budget;
+        for (mwIndex c=task_start[k]; c<task_start[k+1]; ++c) {
+            partitions[c]=solve_component(local_engine, move_function, random_order, submatrix(mod, nodes[c], local, col[t]), component_col[t]);
+        }
+        truncated[k]=local_engine.budget.truncated;
+    });
+    
+    vector<mwIndex> partition(n);
+    mwIndex offset=0;
+    for (mwIndex c=0; c<n_components; ++c) {
+        mwSize k=0;
+        for (mwIndex i=0; i<nodes[c].size(); ++i) {
+            partition[nodes[c][i]]=offset+partitions[c][i];
+            k=max(k, partitions[c][i]+1);
+        }
+        offset+=k;
+    }
+    for (mwIndex k=0; k<n_tasks; ++k) {
+        if (truncated[k]) {
+            e.budget.truncated=true;
+        }
+    }
+    return partition;
+}
+
+//aspect structure from the input arguments N, sizes, types and omega (see aspect_coupling.h)
+static aspect_coupling aspect_arg(const mxArray * const * args, const char * id){
+    mwSize strleng = mxGetM(args[2])*mxGetN(args[2])+1;
+    char * types=(char *) mxCalloc(strleng, sizeof(char));
+    if (mxGetString(args[2], types, strleng)) {
+        mexErrMsgIdAndTxt(id, "aspect types need to be a string");
+    }
+    aspect_coupling coupling;
+    coupling.assign((mwSize) mxGetScalar(args[0]), full(args[1]), types, full(args[3]));
+    mxFree(types);
+    return coupling;
+}
+
+//aggregated matrix P'*mod*P for the partition S (matlab group vector with groups 1,...,k), built
+//one output column at a time from the columns of mod (M is sparse, symmetric_sparse or
+//aspect_matrix)
+template<class M> void aggregate(const M & mod, const full & S, mxArray * & out){
+    mwSize n=mod.n;
+    if (S.m*S.n!=n) {
+        mexErrMsgIdAndTxt("group_handler:aspectnetwork", "partition has wrong size");
+    }
+    vector<mwIndex> group(n);
+    mwSize k=0;
+    for (mwIndex i=0; i<n; ++i) {
+        if (!(S.get(i)>=1)) {
+            mexErrMsgIdAndTxt("group_handler:aspectnetwork", "invalid group index");
+        }
+        group[i]=((mwIndex) S.get(i))-1;
+        k=max(k, group[i]+1);
+    }
+    
+    //nodes of each group (counting sort)
+    vector<mwIndex> start(k+1, 0);
+    for (mwIndex i=0; i<n; ++i) {
+        ++start[group[i]+1];
+    }
+    for (mwIndex g=0; g<k; ++g) {
+        start[g+1]+=start[g];
+    }
+    vector<mwIndex> members(n);
+    vector<mwIndex> pos(start.begin(), start.end()-1);
+    for (mwIndex i=0; i<n; ++i) {
+        members[pos[group[i]]++]=i;
+    }
+    
+    sparse col(mod.m, 1, mod.max_col_nzero());
+    vector<double> acc(k, 0);
+    vector<char> seen(k, false);
+    vector<mwIndex> touched;
+    vector<mwIndex> out_col(k+1, 0);
+    vector<mwIndex> out_row;
+    vector<double> out_val;
+    for (mwIndex g=0; g<k; ++g) {
+        for (mwIndex p=start[g]; p<start[g+1]; ++p) {
+            mod.column(members[p], col);
+            for (mwIndex i=0; i<col.nzero(); ++i) {
+                mwIndex r=group[col.row[i]];
+                if (!seen[r]) {
+                    seen[r]=true;
+                    touched.push_back(r);
+                }
+                acc[r]+=col.val[i];
+            }
+        }
+        sort(touched.begin(), touched.end());
+        for (vector<mwIndex>::iterator it=touched.begin(); it!=touched.end(); ++it) {
+            if (acc[*it]!=0) {
+                out_row.push_back(*it);
+                out_val.push_back(acc[*it]);
+            }
+            acc[*it]=0;
+            seen[*it]=false;
+        }
+        touched.clear();
+        out_col[g+1]=out_row.size();
+    }
+    
+    sparse R(k, k, max(out_row.size(), (size_t) 1));
+    copy(out_row.begin(), out_row.end(), R.row);
+    copy(out_val.begin(), out_val.end(), R.val);
+    copy(out_col.begin(), out_col.end(), R.col);
+    R.export_matlab(out);
+}
 
 //group_handler(handle, varargin)
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
@@ -71,28 +1226,270 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
         }
                 
         if (function_switch.count(handle)) {
-            switch (function_switch.at(handle)) {
+            func f=function_switch.at(handle);
+            
+            //select engine instance (new and delete take no instance)
+            vector<const mxArray *> args;
+            engine & e=(f==NEW_INSTANCE||f==DELETE_INSTANCE) ? engines.default_instance : engines.select(nrhs, prhs, args);
+            group_index & group=e.group;
+            
+            //column buffers of the previous call are dead, reuse their memory
+            e.scratch.rewind();
+            
+            switch (f) {
+                case NEW_INSTANCE: {
+                    if (nrhs!=1||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:new", "new needs no input and 1 output argument");
+                    }
+                    plhs[0]=engines.create();
+                    break;
+                }
+                    
+                case DELETE_INSTANCE: {
+                    if (nrhs!=2) {
+                        mexErrMsgIdAndTxt("group_handler:delete", "delete needs 1 input argument");
+                    }
+                    engines.destroy(prhs[1]);
+                    break;
+                }
+                    
                 case ASSIGN: {
                     if (nrhs!=2) {
-                        mexErrMsgIdAndTxt("group_handler:assign", "assign needs 1 input argument");
+                        mexErrMsgIdAndTxt("group_handler:assign", "assign needs 1 input argument");
+                    }
+                    mwSize n_previous=group.n_nodes;
+                    group=prhs[1];
+                    if (group.n_nodes!=n_previous) {
+                        //new level
+                        e.scratch.reset();
+                    }
+                    e.budget.start_pass();
+                    break;
+                }
+                    
+                case MOVE: {
+                    if (nrhs !=3) {
+                        mexErrMsgIdAndTxt("group_handler:move", "move needs 2 input arguments");
+                    }
+                    double dstep;
+                    mwIndex node=((mwIndex) mxGetScalar(prhs[1]))-1;
+                    if (mxIsSparse(prhs[2])) {
+                        sparse mod_s(prhs[2]);
+                        dstep = move(e, node, mod_s);
+                    } else {
+                        full mod_d(prhs[2]);
+                        dstep = move(e, node, mod_d);
+                    }
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case MOVERAND: {
+                    if (nrhs!=3) {
+                        mexErrMsgIdAndTxt("group_handler:moverand", "move needs 2 input arguments");
+                    }
+                    double dstep;
+                    mwIndex node=((mwIndex) mxGetScalar(prhs[1]))-1;
+                    if (mxIsSparse(prhs[2])) {
+                        sparse mod_s(prhs[2]);
+                        dstep = moverand(e, node, mod_s);
+                    } else {
+                        full mod_d(prhs[2]);
+                        dstep = moverand(e, node, mod_d);
+                    }
+                    
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case MOVERANDW: {
+                    if (nrhs!=3) {
+                        mexErrMsgIdAndTxt("group_handler:moverandw", "move needs 2 input arguments");
+                    }
+                    double dstep;
+                    mwIndex node=((mwIndex) mxGetScalar(prhs[1]))-1;
+                    if (mxIsSparse(prhs[2])) {
+                        sparse mod_s(prhs[2]);
+                        dstep = moverandw(e, node, mod_s);
+                    } else {
+                        full mod_d(prhs[2]);
+                        dstep = moverandw(e, node, mod_d);
+                    }
+                    
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case MOVEALL: {
+                    if (nrhs<4||nrhs>6) {
+                        mexErrMsgIdAndTxt("group_handler:moveall", "moveall needs 3, 4 or 5 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:moveall");
+                    
+                    full order(prhs[2]);
+                    if (mxGetM(prhs[3])!=group.n_nodes||mxGetN(prhs[3])!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:moveall", "modularity matrix has wrong size");
+                    }
+                    double dstep;
+                    if (nrhs>4&&upper_storage(prhs[4])) {
+                        symmetric_sparse mod(prhs[3]);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=moveall(e, move_function, order, mod, col);
+                    }
+                    else if (mxIsSparse(prhs[3])) {
+                        sparse mod(prhs[3]);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=moveall(e, move_function, order, mod, col);
+                    }
+                    else {
+                        full mod(prhs[3]);
+                        if (nrhs>5&&gain_kernel_arg(prhs[5])&&group.n_nodes*group.n_groups<=dense_gain_max) {
+                            dstep=moveall_gain(e, move_function, order, mod);
+                        }
+                        else {
+                            full col=arena_full(e.scratch, mod.m, 1);
+                            dstep=moveall(e, move_function, order, mod, col);
+                        }
+                    }
+                    
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case MOVEBLOCK: {
+                    if (nrhs!=4) {
+                        mexErrMsgIdAndTxt("group_handler:moveblock", "moveblock needs 3 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:moveblock");
+                    
+                    full nodes(prhs[2]);
+                    if (mxGetM(prhs[3])!=group.n_nodes||mxGetN(prhs[3])!=nodes.m*nodes.n) {
+                        mexErrMsgIdAndTxt("group_handler:moveblock", "block of columns has wrong size");
+                    }
+                    double dstep;
+                    if (mxIsSparse(prhs[3])) {
+                        sparse mod(prhs[3]);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=moveblock(e, move_function, nodes, mod, col);
+                    }
+                    else {
+                        full mod(prhs[3]);
+                        full col=arena_full(e.scratch, mod.m, 1);
+                        dstep=moveblock(e, move_function, nodes, mod, col);
+                    }
+                    
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case MOVEFN: {
+                    if (nrhs!=4) {
+                        mexErrMsgIdAndTxt("group_handler:movefn", "movefn needs 3 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:movefn");
+                    if (!mxIsClass(prhs[3], "function_handle")) {
+                        mexErrMsgIdAndTxt("group_handler:movefn", "third argument needs to be a function handle");
+                    }
+                    
+                    full order(prhs[2]);
+                    sparse cached=arena_sparse(e.scratch, group.n_nodes, 1, group.n_nodes);
+                    double dstep=movefn(e, move_function, order, prhs[3], cached);
+                    
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case CACHE: {
+                    if (nrhs!=2) {
+                        mexErrMsgIdAndTxt("group_handler:cache", "cache needs 1 input argument");
                     }
-                    group=prhs[1];
+                    double max_bytes=mxGetScalar(prhs[1]);
+                    if (!(max_bytes>=0)) {
+                        mexErrMsgIdAndTxt("group_handler:cache", "memory limit needs to be non-negative");
+                    }
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleMatrix(1, 2, mxREAL);
+                        mxGetPr(plhs[0])[0]=e.cache.hits;
+                        mxGetPr(plhs[0])[1]=e.cache.misses;
+                    }
+                    e.cache.reset(0, max_bytes);
+                    e.cache.hits=0;
+                    e.cache.misses=0;
                     break;
                 }
                     
-                case MOVE: {
-                    if (nrhs !=3) {
-                        mexErrMsgIdAndTxt("group_handler:move", "move needs 2 input arguments");
+                case MOVEDIRECTED: {
+                    if (nrhs!=7) {
+                        mexErrMsgIdAndTxt("group_handler:movedirected", "movedirected needs 6 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:movedirected");
+                    
+                    full order(prhs[2]);
+                    if (!mxIsSparse(prhs[3])||!mxIsSparse(prhs[4])||!mxIsSparse(prhs[5])) {
+                        mexErrMsgIdAndTxt("group_handler:movedirected", "adjacency matrix and degree sums need to be sparse");
+                    }
+                    if (mxGetM(prhs[3])!=group.n_nodes||mxGetN(prhs[3])!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:movedirected", "adjacency matrix has wrong size");
+                    }
+                    sparse A(prhs[3]);
+                    directed_null null;
+                    null.assign(sparse(prhs[4]), sparse(prhs[5]), full(prhs[6]), group);
+                    sparse col=arena_sparse(e.scratch, A.m, 1, A.max_col_nzero());
+                    double dstep=movedirected(e, move_function, order, A, null, col);
+                    
+                    //output improvement in modularity
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case MOVEASPECTS: {
+                    if (nrhs!=8&&nrhs!=9) {
+                        mexErrMsgIdAndTxt("group_handler:moveaspects", "moveaspects needs 7 or 8 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:moveaspects");
+                    
+                    full order(prhs[2]);
+                    if (!mxIsSparse(prhs[3])) {
+                        mexErrMsgIdAndTxt("group_handler:moveaspects", "intralayer modularity matrix needs to be sparse");
                     }
+                    if (mxGetM(prhs[3])!=group.n_nodes||mxGetN(prhs[3])!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:moveaspects", "intralayer modularity matrix has wrong size");
+                    }
+                    aspect_coupling coupling=aspect_arg(prhs+4, "group_handler:moveaspects");
                     double dstep;
-                    mwIndex node=((mwIndex) * mxGetPr(prhs[1]))-1;
-                    if (mxIsSparse(prhs[2])) {
-                        sparse mod_s(prhs[2]);
-                        dstep = move(group, node, mod_s);
-                    } else {
-                        full mod_d(prhs[2]);
-                        dstep = move(group, node, mod_d);
+                    if (nrhs==9&&upper_storage(prhs[8])) {
+                        symmetric_sparse intra(prhs[3]);
+                        aspect_matrix<symmetric_sparse> mod(intra, coupling);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=moveall(e, move_function, order, mod, col);
+                    }
+                    else {
+                        sparse intra(prhs[3]);
+                        aspect_matrix<sparse> mod(intra, coupling);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=moveall(e, move_function, order, mod, col);
                     }
+                    
                     //output improvement in modularity
                     if (nlhs>0) {
                         plhs[0]=mxCreateDoubleScalar(dstep);
@@ -100,18 +1497,43 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     break;
                 }
                     
-                case MOVERAND: {
-                    if (nrhs!=3) {
-                        mexErrMsgIdAndTxt("group_handler:moverand", "move needs 2 input arguments");
+                case MOVECOUPLED: {
+                    if (nrhs!=6&&nrhs!=7) {
+                        mexErrMsgIdAndTxt("group_handler:movecoupled", "movecoupled needs 5 or 6 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:movecoupled");
+                    
+                    full order(prhs[2]);
+                    if (mxGetM(prhs[3])!=group.n_nodes||mxGetN(prhs[3])!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:movecoupled", "modularity matrix has wrong size");
+                    }
+                    mwSize T=(mwSize) mxGetScalar(prhs[4]);
+                    if (T==0||group.n_nodes%T) {
+                        mexErrMsgIdAndTxt("group_handler:movecoupled", "number of layers needs to divide the number of nodes");
                     }
+                    mwSize strleng = mxGetM(prhs[5])*mxGetN(prhs[5])+1;
+                    char * type=(char *) mxCalloc(strleng, sizeof(char));
+                    if (mxGetString(prhs[5], type, strleng)||(strcmp(type, "ordinal")&&strcmp(type, "categorical"))) {
+                        mexErrMsgIdAndTxt("group_handler:movecoupled", "coupling type needs to be 'ordinal' or 'categorical'");
+                    }
+                    bool categorical=!strcmp(type, "categorical");
+                    mxFree(type);
+                    
                     double dstep;
-                    mwIndex node=((mwIndex) * mxGetPr(prhs[1]))-1;
-                    if (mxIsSparse(prhs[2])) {
-                        sparse mod_s(prhs[2]);
-                        dstep = moverand(group, node, mod_s);
-                    } else {
-                        full mod_d(prhs[2]);
-                        dstep = moverand(group, node, mod_d);
+                    if (nrhs==7&&upper_storage(prhs[6])) {
+                        symmetric_sparse mod(prhs[3]);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=movecoupled(e, move_function, order, T, categorical, mod, col);
+                    }
+                    else if (mxIsSparse(prhs[3])) {
+                        sparse mod(prhs[3]);
+                        sparse col=arena_sparse(e.scratch, mod.m, 1, mod.max_col_nzero());
+                        dstep=movecoupled(e, move_function, order, T, categorical, mod, col);
+                    }
+                    else {
+                        full mod(prhs[3]);
+                        full col=arena_full(e.scratch, mod.m, 1);
+                        dstep=movecoupled(e, move_function, order, T, categorical, mod, col);
                     }
                     
                     //output improvement in modularity
@@ -121,18 +1543,51 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     break;
                 }
                     
-                case MOVERANDW: {
-                    if (nrhs!=3) {
-                        mexErrMsgIdAndTxt("group_handler:moverandw", "move needs 2 input arguments");
+                case MOVELAYERS: {
+                    if (nrhs<6||nrhs>8) {
+                        mexErrMsgIdAndTxt("group_handler:movelayers", "movelayers needs 5, 6 or 7 input arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:movelayers");
+                    
+                    full order(prhs[2]);
+                    if (mxGetM(prhs[3])!=group.n_nodes||mxGetN(prhs[3])!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:movelayers", "modularity matrix has wrong size");
                     }
+                    mwSize T=(mwSize) mxGetScalar(prhs[4]);
+                    if (T==0||group.n_nodes%T) {
+                        mexErrMsgIdAndTxt("group_handler:movelayers", "number of layers needs to divide the number of nodes");
+                    }
+                    mwSize block_layers=(mwSize) mxGetScalar(prhs[5]);
+                    if (block_layers==0) {
+                        mexErrMsgIdAndTxt("group_handler:movelayers", "number of layers per block needs to be positive");
+                    }
+                    block_layers=std::min(block_layers, T);
+                    bool upper=(nrhs>6&&upper_storage(prhs[6]));
+                    unsigned n_threads=thread_count(nrhs>7 ? (unsigned) mxGetScalar(prhs[7]) : 0, (T+block_layers-1)/block_layers);
+                    mwSize block_size=block_layers*(group.n_nodes/T);
+                    
                     double dstep;
-                    mwIndex node=((mwIndex) * mxGetPr(prhs[1]))-1;
-                    if (mxIsSparse(prhs[2])) {
-                        sparse mod_s(prhs[2]);
-                        dstep = moverandw(group, node, mod_s);
-                    } else {
-                        full mod_d(prhs[2]);
-                        dstep = moverandw(group, node, mod_d);
+                    if (upper||mxIsSparse(prhs[3])) {
+                        vector<sparse> col;
+                        vector<sparse> block_col;
+                        if (upper) {
+                            symmetric_sparse mod(prhs[3]);
+                            col=arena_sparse_columns(e.scratch, n_threads, mod.m, mod.max_col_nzero());
+                            block_col=arena_sparse_columns(e.scratch, n_threads, block_size, mod.max_col_nzero());
+                            dstep=movelayers(e, move_function, order, T, block_layers, mod, col, block_col);
+                        }
+                        else {
+                            sparse mod(prhs[3]);
+                            col=arena_sparse_columns(e.scratch, n_threads, mod.m, mod.max_col_nzero());
+                            block_col=arena_sparse_columns(e.scratch, n_threads, block_size, mod.max_col_nzero());
+                            dstep=movelayers(e, move_function, order, T, block_layers, mod, col, block_col);
+                        }
+                    }
+                    else {
+                        full mod(prhs[3]);
+                        vector<full> col=arena_full_columns(e.scratch, n_threads, mod.m);
+                        vector<full> block_col=arena_full_columns(e.scratch, n_threads, block_size);
+                        dstep=movelayers(e, move_function, order, T, block_layers, mod, col, block_col);
                     }
                     
                     //output improvement in modularity
@@ -142,9 +1597,237 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     break;
                 }
                     
+                case COMPONENTS: {
+                    if (nrhs<2||nrhs>3||nlhs<1) {
+                        mexErrMsgIdAndTxt("group_handler:components", "components needs 1 or 2 input and at least 1 output argument");
+                    }
+                    if (!mxIsSparse(prhs[1])) {
+                        mexErrMsgIdAndTxt("group_handler:components", "components needs a sparse modularity matrix");
+                    }
+                    mwSize n_components;
+                    vector<mwIndex> components;
+                    if (nrhs==3&&upper_storage(prhs[2])) {
+                        components=positive_components(symmetric_sparse(prhs[1]), n_components);
+                    }
+                    else {
+                        components=positive_components(sparse(prhs[1]), n_components);
+                    }
+                    full c(components.size(),1);
+                    for (mwIndex i=0; i<components.size(); ++i) {
+                        c.get(i)=components[i]+1;
+                    }
+                    c.export_matlab(plhs[0]);
+                    if (nlhs>1) {
+                        plhs[1]=mxCreateDoubleScalar(n_components);
+                    }
+                    break;
+                }
+                    
+                case SOLVECOMPONENTS: {
+                    if (nrhs<5||nrhs>7||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:solvecomponents", "solvecomponents needs 4, 5 or 6 input and 1 output argument");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:solvecomponents");
+                    if (!mxIsSparse(prhs[2])) {
+                        mexErrMsgIdAndTxt("group_handler:solvecomponents", "solvecomponents needs a sparse modularity matrix");
+                    }
+                    mwSize n=mxGetN(prhs[2]);
+                    if (mxGetM(prhs[2])!=n||mxGetM(prhs[3])*mxGetN(prhs[3])!=n) {
+                        mexErrMsgIdAndTxt("group_handler:solvecomponents", "modularity matrix and components have incompatible sizes");
+                    }
+                    full c(prhs[3]);
+                    vector<mwIndex> components(n);
+                    for (mwIndex i=0; i<n; ++i) {
+                        components[i]=((mwIndex) c.get(i))-1;
+                    }
+                    bool random_order=mxGetScalar(prhs[4])!=0;
+                    unsigned n_threads=nrhs>6 ? (unsigned) mxGetScalar(prhs[6]) : 0;
+                    if (nrhs>5&&upper_storage(prhs[5])) {
+                        group=solvecomponents(e, move_function, random_order, symmetric_sparse(prhs[2]), components, n_threads);
+                    }
+                    else {
+                        group=solvecomponents(e, move_function, random_order, sparse(prhs[2]), components, n_threads);
+                    }
+                    group.export_matlab(plhs[0]);
+                    break;
+                }
+                    
+                case SOLVETINY: {
+                    if (nrhs<4||nrhs>5||nlhs<1) {
+                        mexErrMsgIdAndTxt("group_handler:solvetiny", "solvetiny needs 3 or 4 input and 1 or 2 output arguments");
+                    }
+                    func move_function=move_function_arg(prhs[1], "group_handler:solvetiny");
+                    mwSize n=mxGetN(prhs[2]);
+                    if (mxGetM(prhs[2])!=n||n!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:solvetiny", "modularity matrix has wrong size");
+                    }
+                    if (n>tiny_max) {
+                        mexErrMsgIdAndTxt("group_handler:solvetiny", "solvetiny needs a network with at most %d nodes", (int) tiny_max);
+                    }
+                    bool random_order=mxGetScalar(prhs[3])!=0;
+                    vector<double> A;
+                    if (nrhs>4&&upper_storage(prhs[4])) {
+                        dense_copy(symmetric_sparse(prhs[2]), A);
+                    }
+                    else if (mxIsSparse(prhs[2])) {
+                        dense_copy(sparse(prhs[2]), A);
+                    }
+                    else {
+                        dense_copy(full(prhs[2]), A);
+                    }
+                    double dstep=0;
+                    group=solve_tiny(e, move_function, random_order, A, n, dstep);
+                    group.export_matlab(plhs[0]);
+                    if (nlhs>1) {
+                        plhs[1]=mxCreateDoubleScalar(dstep);
+                    }
+                    break;
+                }
+                    
+                case PROPAGATE: {
+                    if (nrhs<3||nrhs>5||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:propagate", "propagate needs 2, 3 or 4 input and 1 output argument");
+                    }
+                    if (mxGetM(prhs[1])!=group.n_nodes||mxGetN(prhs[1])!=group.n_nodes) {
+                        mexErrMsgIdAndTxt("group_handler:propagate", "modularity matrix has wrong size");
+                    }
+                    mwSize max_iter=(mwSize) mxGetScalar(prhs[2]);
+                    bool upper=(nrhs>3&&upper_storage(prhs[3]));
+                    unsigned n_threads=thread_count(nrhs>4 ? (unsigned) mxGetScalar(prhs[4]) : 0, (group.n_nodes+propagate_batch-1)/propagate_batch);
+                    if (upper) {
+                        symmetric_sparse mod(prhs[1]);
+                        vector<sparse> col=arena_sparse_columns(e.scratch, n_threads, mod.m, mod.max_col_nzero());
+                        group=propagate_labels(e, mod, max_iter, n_threads, col);
+                    }
+                    else if (mxIsSparse(prhs[1])) {
+                        sparse mod(prhs[1]);
+                        vector<sparse> col=arena_sparse_columns(e.scratch, n_threads, mod.m, mod.max_col_nzero());
+                        group=propagate_labels(e, mod, max_iter, n_threads, col);
+                    }
+                    else {
+                        full mod(prhs[1]);
+                        vector<full> col=arena_full_columns(e.scratch, n_threads, mod.m);
+                        group=propagate_labels(e, mod, max_iter, n_threads, col);
+                    }
+                    group.export_matlab(plhs[0]);
+                    break;
+                }
+                    
+                case ASPECTNETWORK: {
+                    if (nrhs!=7&&nrhs!=8) {
+                        mexErrMsgIdAndTxt("group_handler:aspectnetwork", "aspectnetwork needs 6 or 7 input arguments");
+                    }
+                    if (!mxIsSparse(prhs[1])) {
+                        mexErrMsgIdAndTxt("group_handler:aspectnetwork", "intralayer modularity matrix needs to be sparse");
+                    }
+                    aspect_coupling coupling=aspect_arg(prhs+2, "group_handler:aspectnetwork");
+                    full S(prhs[6]);
+                    if (nrhs==8&&upper_storage(prhs[7])) {
+                        symmetric_sparse intra(prhs[1]);
+                        aggregate(aspect_matrix<symmetric_sparse>(intra, coupling), S, plhs[0]);
+                    }
+                    else {
+                        sparse intra(prhs[1]);
+                        aggregate(aspect_matrix<sparse>(intra, coupling), S, plhs[0]);
+                    }
+                    break;
+                }
+                    
+                case FOLD: {
+                    if (nrhs<3||nrhs>4||nlhs<1) {
+                        mexErrMsgIdAndTxt("group_handler:fold", "fold needs 2 or 3 input and at least 1 output argument");
+                    }
+                    if (!mxIsSparse(prhs[1])) {
+                        mexErrMsgIdAndTxt("group_handler:fold", "fold needs a sparse modularity matrix");
+                    }
+                    mwSize strleng = mxGetM(prhs[2])*mxGetN(prhs[2])+1;
+                    char * method=(char *) mxCalloc(strleng, sizeof(char));
+                    if (mxGetString(prhs[2], method, strleng)||(strcmp(method, "pendant")&&strcmp(method, "all"))) {
+                        mexErrMsgIdAndTxt("group_handler:fold", "method needs to be 'pendant' or 'all'");
+                    }
+                    bool twins=!strcmp(method, "all");
+                    mxFree(method);
+                    mwSize n_folded;
+                    vector<mwIndex> folded;
+                    if (nrhs==4&&upper_storage(prhs[3])) {
+                        folded=fold_nodes(symmetric_sparse(prhs[1]), twins, n_folded);
+                    }
+                    else {
+                        folded=fold_nodes(sparse(prhs[1]), twins, n_folded);
+                    }
+                    full R(folded.size(),1);
+                    for (mwIndex i=0; i<folded.size(); ++i) {
+                        R.get(i)=folded[i]+1;
+                    }
+                    R.export_matlab(plhs[0]);
+                    if (nlhs>1) {
+                        plhs[1]=mxCreateDoubleScalar(n_folded);
+                    }
+                    break;
+                }
+                    
+                case ISSYMMETRIC: {
+                    if (nrhs!=2) {
+                        mexErrMsgIdAndTxt("group_handler:issymmetric", "issymmetric needs 1 input argument");
+                    }
+                    bool symmetric;
+                    if (mxIsSparse(prhs[1])) {
+                        symmetric=sparse(prhs[1]).is_symmetric();
+                    }
+                    else {
+                        symmetric=full(prhs[1]).is_symmetric();
+                    }
+                    plhs[0]=mxCreateLogicalScalar(symmetric);
+                    break;
+                }
+                    
+                case REORDER: {
+                    if (nrhs<3||nrhs>4||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:reorder", "reorder needs 2 or 3 input and 1 output argument");
+                    }
+                    mwSize strleng = mxGetM(prhs[1])*mxGetN(prhs[1])+1;
+                    char * method=(char *) mxCalloc(strleng, sizeof(char));
+                    if (mxGetString(prhs[1], method, strleng)) {
+                        mexErrMsgIdAndTxt("group_handler:reorder", "method needs to be a string");
+                    }
+                    vector<mwIndex> order;
+                    if (!strcmp(method, "interleave")) {
+                        if (nrhs!=4) {
+                            mexErrMsgIdAndTxt("group_handler:reorder", "interleave needs the number of nodes and layers as input");
+                        }
+                        order=interleave_order((mwSize) mxGetScalar(prhs[2]), (mwSize) mxGetScalar(prhs[3]));
+                    }
+                    else if (!strcmp(method, "rcm")||!strcmp(method, "bfs")) {
+                        if (!mxIsSparse(prhs[2])) {
+                            mexErrMsgIdAndTxt("group_handler:reorder", "reordering needs a sparse modularity matrix");
+                        }
+                        bool cuthill_mckee=!strcmp(method, "rcm");
+                        if (nrhs==4&&upper_storage(prhs[3])) {
+                            order=bfs_order(symmetric_sparse(prhs[2]), cuthill_mckee);
+                        }
+                        else {
+                            order=bfs_order(sparse(prhs[2]), cuthill_mckee);
+                        }
+                    }
+                    else {
+                        mexErrMsgIdAndTxt("group_handler:reorder", "method needs to be 'rcm', 'bfs' or 'interleave'");
+                    }
+                    mxFree(method);
+                    
+                    full perm(order.size(),1);
+                    for (mwIndex i=0; i<order.size(); ++i) {
+                        perm.get(i)=order[i]+1;
+                    }
+                    perm.export_matlab(plhs[0]);
+                    break;
+                }
+                    
                 case RETURN: {
+                    if (nrhs>2) {
+                        mexErrMsgIdAndTxt("group_handler:return", "return needs at most 1 input argument");
+                    }
                     if (nlhs>0) {
-                        group.export_matlab(plhs[0]);
+                        group.export_matlab(plhs[0], (nrhs==2&&uint32_output(prhs[1])) ? mxUINT32_CLASS : mxDOUBLE_CLASS);
                     }
                     else {
                         mexErrMsgIdAndTxt("group_handler:return", "need ouput argument to return");
@@ -152,6 +1835,86 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     break;
                 }
                     
+                case QUALITY: {
+                    if ((nrhs<3||nrhs>5)||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:quality", "quality needs 2, 3 or 4 input and 1 output argument");
+                    }
+                    partition_batch partitions(prhs[2]);
+                    full Q;
+                    if (nrhs==5) {
+                        //multilayer modularity with uniform coupling
+                        mwSize strleng = mxGetM(prhs[4])*mxGetN(prhs[4])+1;
+                        char * type=(char *) mxCalloc(strleng, sizeof(char));
+                        if (mxGetString(prhs[4], type, strleng)||(strcmp(type, "ordinal")&&strcmp(type, "categorical"))) {
+                            mexErrMsgIdAndTxt("group_handler:quality", "coupling type needs to be 'ordinal' or 'categorical'");
+                        }
+                        Q=multilayer_quality(partitions, prhs[1], mxGetScalar(prhs[3]), !strcmp(type, "categorical"));
+                    }
+                    else {
+                        if (!mxIsClass(prhs[1], "function_handle")&&(mxGetM(prhs[1])!=partitions.n_nodes||mxGetN(prhs[1])!=partitions.n_nodes)) {
+                            mexErrMsgIdAndTxt("group_handler:quality", "modularity matrix and partitions have incompatible sizes");
+                        }
+                        if (nrhs==4&&upper_storage(prhs[3])) {
+                            Q=quality(partitions, symmetric_sparse(prhs[1]));
+                        }
+                        else {
+                            Q=quality(partitions, prhs[1]);
+                        }
+                    }
+                    Q.export_matlab(plhs[0]);
+                    break;
+                }
+                    
+                case SAVE: {
+                    if (nrhs!=3) {
+                        mexErrMsgIdAndTxt("group_handler:save", "save needs 2 input arguments");
+                    }
+                    char * filename=mxArrayToString(prhs[1]);
+                    if (filename==NULL) {
+                        mexErrMsgIdAndTxt("group_handler:save", "file name needs to be a string");
+                    }
+                    ostringstream rng_state;
+                    rng_state << e.generator;
+                    write_checkpoint(filename, prhs[2], rng_state.str());
+                    mxFree(filename);
+                    break;
+                }
+                    
+                case LOAD: {
+                    if (nrhs!=2||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:load", "load needs 1 input and 1 output argument");
+                    }
+                    char * filename=mxArrayToString(prhs[1]);
+                    if (filename==NULL) {
+                        mexErrMsgIdAndTxt("group_handler:load", "file name needs to be a string");
+                    }
+                    string rng_state;
+                    plhs[0]=read_checkpoint(filename, rng_state);
+                    istringstream rng_stream(rng_state);
+                    rng_stream >> e.generator;
+                    if (rng_stream.fail()) {
+                        mexErrMsgIdAndTxt("group_handler:load", "invalid random number generator state in checkpoint");
+                    }
+                    mxFree(filename);
+                    break;
+                }
+                    
+                case BUDGET: {
+                    if (nrhs!=3) {
+                        mexErrMsgIdAndTxt("group_handler:budget", "budget needs 2 input arguments");
+                    }
+                    e.budget.set(mxGetScalar(prhs[1]), mxGetScalar(prhs[2]));
+                    break;
+                }
+                    
+                case TRUNCATED: {
+                    if (nrhs!=1||nlhs!=1) {
+                        mexErrMsgIdAndTxt("group_handler:truncated", "truncated needs no input and 1 output argument");
+                    }
+                    plhs[0]=mxCreateLogicalScalar(e.budget.expired());
+                    break;
+                }
+                    
                 default: {
                     mexErrMsgIdAndTxt("metanetwork_reduce:switch","switch implementation error");
                     break;
@@ -167,8 +1930,11 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
 
 
 //find possible moves
-set_type possible_moves(group_index & g, mwIndex node, const sparse & mod){
-    set_type unique_groups(g.n_groups);
+set_type & possible_moves(group_index & g, move_workspace & w, mwIndex node, const sparse & mod){
+    if (w.mod_c.size()<g.n_groups) {
+        w.resize(g.n_groups);
+    }
+    set_type & unique_groups=w.unique_groups;
     unique_groups.insert(g.nodes[node]);
     //add nodes with potential positive contribution to unique_groups
     for(mwIndex i=0; i<mod.nzero(); ++i){
@@ -180,8 +1946,11 @@ set_type possible_moves(group_index & g, mwIndex node, const sparse & mod){
 }
 
 
-set_type possible_moves(group_index & g, mwIndex node, const full & mod){
-    set_type unique_groups(g.n_groups);
+set_type & possible_moves(group_index & g, move_workspace & w, mwIndex node, const full & mod){
+    if (w.mod_c.size()<g.n_groups) {
+        w.resize(g.n_groups);
+    }
+    set_type & unique_groups=w.unique_groups;
     unique_groups.insert(g.nodes[node]);
     //add nodes with potential positive contribution to unique_groups
     for(mwIndex i=0; i<g.n_nodes; ++i){
@@ -194,19 +1963,13 @@ set_type possible_moves(group_index & g, mwIndex node, const full & mod){
 
 
 //calculates changes in modularity for full modularity matrix
-map_type mod_change(group_index &g, const full & mod, set_type & unique_groups, mwIndex current_node){
+map_type & mod_change(group_index &g, move_workspace & w, const full & mod, set_type & unique_groups, mwIndex current_node){
     mwIndex current_group=g.nodes[current_node];
-    map_type mod_c;
-    double mod_current= mod[current_node];
-    for (set_type::iterator it1=unique_groups.begin(); it1!=unique_groups.end(); ++it1) {
-        double mod_c_group=0;
-        for(list<mwIndex>::iterator it2=g.groups[*it1].begin(); it2!=g.groups[*it1].end(); ++it2){
-            mod_c_group+=mod.get(*it2);
-        }
-        mod_c[*it1]=mod_c_group;
-    }
-    mod_c[current_group]-=mod_current;
-    mod_current=mod_c[current_group];
+    map_type & mod_c=w.mod_c;
+    //accumulate column for each group (entries of groups that are not possible moves are ignored)
+    scatter_add(mod_c.data(), g.nodes.data(), mod.val, g.n_nodes);
+    mod_c[current_group]-=mod[current_node];
+    double mod_current=mod_c[current_group];
     for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
         mod_c[*it]-=mod_current;
     }
@@ -215,22 +1978,48 @@ map_type mod_change(group_index &g, const full & mod, set_type & unique_groups,
 }
 
 
-//calculates changes in modularity for sparse modularity matrix
-map_type mod_change(group_index & g, const sparse & mod, set_type & unique_groups, mwIndex current_node){
-    mwIndex current_group=g.nodes[current_node];
-    map_type mod_c;
-    double mod_current=mod.get(current_node, 0);
-    for(set_type::iterator it=unique_groups.begin(); it!=unique_groups.end();++it){
-        mod_c[*it]=0;
+//find possible moves from the row of the node-to-group matrix
+set_type & possible_moves(group_index & g, move_workspace & w, mwIndex node, const gain_row & mod){
+    if (w.mod_c.size()<g.n_groups) {
+        w.resize(g.n_groups);
     }
-    //calculate changes in modularity
-    for (mwIndex i=0; i<mod.nzero(); ++i) {
-        if (unique_groups.count(g.nodes[mod.row[i]])) {
-            mod_c[g.nodes[mod.row[i]]]+=mod.val[i];
+    set_type & unique_groups=w.unique_groups;
+    unique_groups.insert(g.nodes[node]);
+    //add nodes with potential positive contribution to unique_groups (same candidates and order
+    //as for the column of a full matrix)
+    for(mwIndex i=0; i<g.n_nodes; ++i){
+        if(mod.col[i]>0){
+            unique_groups.insert(g.nodes[i]);
         }
     }
-    mod_c[current_group]-=mod_current;
-    mod_current=mod_c[current_group];
+    return unique_groups;
+}
+
+
+//calculates changes in modularity from the row of the node-to-group matrix
+map_type & mod_change(group_index & g, move_workspace & w, const gain_row & mod, set_type & unique_groups, mwIndex current_node){
+    mwIndex current_group=g.nodes[current_node];
+    map_type & mod_c=w.mod_c;
+    for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
+        mod_c[*it]=mod.get(*it);
+    }
+    mod_c[current_group]-=mod.self;
+    double mod_current=mod_c[current_group];
+    for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
+        mod_c[*it]-=mod_current;
+    }
+    return mod_c;
+}
+
+
+//calculates changes in modularity for sparse modularity matrix
+map_type & mod_change(group_index & g, move_workspace & w, const sparse & mod, set_type & unique_groups, mwIndex current_node){
+    mwIndex current_group=g.nodes[current_node];
+    map_type & mod_c=w.mod_c;
+    //accumulate column for each group (entries of groups that are not possible moves are ignored)
+    scatter_add(mod_c.data(), g.nodes.data(), mod.row, mod.val, mod.nzero());
+    mod_c[current_group]-=mod.get(current_node, 0);
+    double mod_current=mod_c[current_group];
     for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
         mod_c[*it]-=mod_current;
     }
@@ -249,4 +2038,55 @@ move_list positive_moves(set_type & unique_groups, map_type & mod_c){
     return moves;
 }
 
+//accumulate column of state node in run for the groups of all nodes outside run
+void coupled_gain(group_index & g, move_workspace & w, const state_run & run, mwIndex state, const sparse & col, double & current, double & internal){
+    mwIndex group=g.nodes[state];
+    w.unique_groups.insert(group);
+    w.targets.insert(group);
+    for (mwIndex i=0; i<col.nzero(); ++i) {
+        mwIndex node=col.row[i];
+        if (run.contains(node)) {
+            //entries between copies are counted from both sides
+            if (node!=state&&g.nodes[node]!=group) {
+                internal+=col.val[i]/2;
+            }
+        }
+        else {
+            mwIndex node_group=g.nodes[node];
+            w.mod_c[node_group]+=col.val[i];
+            w.unique_groups.insert(node_group);
+            if (col.val[i]>0) {
+                w.targets.insert(node_group);
+            }
+            if (node_group==group) {
+                current+=col.val[i];
+            }
+        }
+    }
+}
+
 
+void coupled_gain(group_index & g, move_workspace & w, const state_run & run, mwIndex state, const full & col, double & current, double & internal){
+    mwIndex group=g.nodes[state];
+    w.unique_groups.insert(group);
+    w.targets.insert(group);
+    for (mwIndex node=0; node<g.n_nodes; ++node) {
+        if (run.contains(node)) {
+            //entries between copies are counted from both sides
+            if (node!=state&&g.nodes[node]!=group) {
+                internal+=col.get(node)/2;
+            }
+        }
+        else {
+            mwIndex node_group=g.nodes[node];
+            w.mod_c[node_group]+=col.get(node);
+            w.unique_groups.insert(node_group);
+            if (col.get(node)>0) {
+                w.targets.insert(node_group);
+            }
+            if (node_group==group) {
+                current+=col.get(node);
+            }
+        }
+    }
+}
@@ -18,20 +18,26 @@
 
 #include "matlab_matrix.h"
 #include "group_index.h"
+#include "gain_kernel.h"
+#include "column_cache.h"
+#include "arena.h"
 #include <cstring>
 #include <unordered_map>
 #include <set>
 #include <vector>
 #include <random>
 #include <ctime>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <utility>
 
 #define NUM_TOL 1e-10
 
 
-typedef std::unordered_map<mwIndex, double> map_type;
+//typedef std::unordered_map<mwIndex, double> map_type;
 //typedef std::map<mwIndex, double> map_type;
-//typedef std::vector<double> map_type;
+typedef std::vector<double> map_type; //dense gain for each group
 
 //map for unique possible moves
 struct unique_group_map {
@@ -41,6 +47,7 @@ struct unique_group_map {
     std::vector<mwIndex> members;
     bool count(mwIndex i);
     void insert(mwIndex i);
+    void clear(); //only resets the current members
     typedef std::vector<mwIndex>::iterator iterator;
     iterator begin();
     iterator end();
@@ -50,26 +57,115 @@ typedef unique_group_map set_type;
 
 typedef std::pair<std::vector<mwIndex>,std::vector<double>> move_list;
 
+//row of the node-to-group matrix G=B*P of a full modularity matrix B (G(i,c) is the sum of
+//B(i,j) over the nodes j in group c), used in place of the column of B to move node (the
+//column only selects the candidate groups)
+struct gain_row {
+    double get(mwIndex group) const {return row[group*stride];}
+    const double * row; //G(node,0), entries of the other groups at a stride of n
+    const double * col; //B(:,node)
+    mwSize stride;
+    double self; //B(node,node)
+};
+
+//node-to-group matrix G=B*P for a full (symmetric) modularity matrix, stored by columns such
+//that the update when a node moves (two columns of G) is contiguous. G is built once per pass
+//(O(n^2)) and the gains of a move are read from the row of the node instead of being
+//accumulated from its column. release() frees G at the end of the pass.
+struct dense_gain {
+    dense_gain();
+    void build(const group_index & g, const full & mod);
+    void update(const full & mod, mwIndex node, mwIndex from, mwIndex to);
+    gain_row row(const full & mod, mwIndex node) const;
+    void release();
+    mwSize n;
+    mwSize k;
+    std::vector<double> G;
+};
+
+//persistent work space for a single move (sized to the number of groups). Only the entries
+//touched by a move are reset afterwards so that moving a node does not cost O(n_groups).
+struct move_workspace {
+    void resize(mwSize n);
+    void clear(const group_index & g, const sparse & mod);
+    void clear(const group_index & g, const full & mod);
+    void clear(const group_index & g, const gain_row & mod);
+    void clear(); //resets the entries of unique_groups and clears targets (used by coupled moves)
+    set_type unique_groups;
+    set_type targets; //candidate groups of a coupled move
+    map_type mod_c;
+};
+
+//copies of a physical node in the layers first,...,last of a multilayer network with N nodes
+//per layer (the copy in layer t is state node node+t*N)
+struct state_run {
+    state_run(mwIndex node, mwSize N, mwIndex first, mwIndex last);
+    bool contains(mwIndex i) const;
+    mwIndex node;
+    mwSize N;
+    mwIndex first;
+    mwIndex last;
+};
+
+//wall-clock and pass budget of a run. Passes are counted when a partition is assigned, once
+//the budget is exhausted all further moves are skipped and the run is marked as truncated.
+struct run_budget {
+    run_budget();
+    void set(double seconds, double passes); //inf for no limit, resets the pass count
+    void start_pass();
+    bool expired();
+    bool has_deadline;
+    std::chrono::steady_clock::time_point deadline;
+    double max_passes;
+    double passes;
+    bool truncated;
+};
+
+//state of a clustering engine instance: current partition, work space for moves, random
+//number generator, budget and arena for the column buffers of the handles (instances are
+//independent and can be used concurrently)
+struct engine {
+    engine();
+    group_index group;
+    move_workspace workspace;
+    std::default_random_engine generator;
+    run_budget budget;
+    column_cache cache;
+    dense_gain gain;
+    arena scratch; //rewound by every call, reset when a level with a new number of nodes is assigned
+};
+
 
 //move node to most optimal group
-template<class M> double move(group_index & g, mwIndex node, const M & mod);
+template<class M> double move(engine & e, mwIndex node, const M & mod);
 
 //move node to random group that increases modularity
-template<class M> double moverand(group_index & g, mwIndex node, const M & mod);
+template<class M> double moverand(engine & e, mwIndex node, const M & mod);
 
 //move node to random group with probability proportional to increase in modularity
-template<class M> double moverandw(group_index & g, mwIndex node, const M & mod);
+template<class M> double moverandw(engine & e, mwIndex node, const M & mod);
 
-set_type possible_moves(group_index & g, mwIndex node, const sparse & mod);
+set_type & possible_moves(group_index & g, move_workspace & w, mwIndex node, const sparse & mod);
 
-set_type possible_moves(group_index & g, mwIndex node, const full & mod);
+set_type & possible_moves(group_index & g, move_workspace & w, mwIndex node, const full & mod);
 
-map_type mod_change(group_index &g, const sparse &mod,set_type & unique_groups,mwIndex current_node);
+set_type & possible_moves(group_index & g, move_workspace & w, mwIndex node, const gain_row & mod);
 
-map_type mod_change(group_index &g, const full & mod, set_type & unique_groups, mwIndex current_node);
+map_type & mod_change(group_index &g, move_workspace & w, const sparse &mod,set_type & unique_groups,mwIndex current_node);
+
+map_type & mod_change(group_index &g, move_workspace & w, const full & mod, set_type & unique_groups, mwIndex current_node);
+
+map_type & mod_change(group_index &g, move_workspace & w, const gain_row & mod, set_type & unique_groups, mwIndex current_node);
 
 move_list positive_moves(set_type & unique_groups, map_type & mod_c);
 
+//improving moves of all state nodes in run to the same group (C is the column buffer for mod)
+template<class M, class C> move_list coupled_moves(engine & e, const state_run & run, const M & mod, C & col);
+
+void coupled_gain(group_index & g, move_workspace & w, const state_run & run, mwIndex state, const sparse & col, double & current, double & internal);
+
+void coupled_gain(group_index & g, move_workspace & w, const state_run & run, mwIndex state, const full & col, double & current, double & internal);
+
 
 //implement unique_group_map (quick membership check and insertion of elements, quick iteration over members, unordered)
 unique_group_map::unique_group_map() : ismember(std::vector<bool>()) {}
@@ -81,13 +177,135 @@ void unique_group_map::insert(mwIndex i) {
         members.push_back(i);
     }
 }
+void unique_group_map::clear() {
+    for (iterator it=members.begin(); it!=members.end(); ++it) {
+        ismember[*it]=false;
+    }
+    members.clear();
+}
 unique_group_map::iterator unique_group_map::begin() { return members.begin(); }
 unique_group_map::iterator unique_group_map::end() { return members.end(); }
 
+//implement move_workspace
+void move_workspace::resize(mwSize n) {
+    unique_groups=unique_group_map(n);
+    targets=unique_group_map(n);
+    mod_c.assign(n,0);
+}
+void move_workspace::clear(const group_index & g, const sparse & mod) {
+    for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
+        mod_c[*it]=0;
+    }
+    for (mwIndex i=0; i<mod.nzero(); ++i) {
+        mod_c[g.nodes[mod.row[i]]]=0;
+    }
+    unique_groups.clear();
+}
+void move_workspace::clear(const group_index & g, const full &) {
+    for (mwIndex i=0; i<g.n_nodes; ++i) {
+        mod_c[g.nodes[i]]=0;
+    }
+    unique_groups.clear();
+}
+void move_workspace::clear(const group_index &, const gain_row &) {
+    for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
+        mod_c[*it]=0;
+    }
+    unique_groups.clear();
+}
+void move_workspace::clear() {
+    for (set_type::iterator it=unique_groups.begin(); it!=unique_groups.end(); ++it) {
+        mod_c[*it]=0;
+    }
+    unique_groups.clear();
+    targets.clear();
+}
+
+//implement dense_gain
+dense_gain::dense_gain() : n(0), k(0) {}
+void dense_gain::build(const group_index & g, const full & mod) {
+    n=g.n_nodes;
+    k=g.n_groups;
+    G.assign(n*k, 0);
+    //column c of G accumulates the columns of B of the nodes in group c
+    for (mwIndex j=0; j<n; ++j) {
+        const double * col=mod.val+j*mod.m;
+        double * group_col=G.data()+g.nodes[j]*n;
+        for (mwIndex i=0; i<n; ++i) {
+            group_col[i]+=col[i];
+        }
+    }
+}
+void dense_gain::update(const full & mod, mwIndex node, mwIndex from, mwIndex to) {
+    const double * col=mod.val+node*mod.m;
+    double * from_col=G.data()+from*n;
+    double * to_col=G.data()+to*n;
+    for (mwIndex i=0; i<n; ++i) {
+        from_col[i]-=col[i];
+    }
+    for (mwIndex i=0; i<n; ++i) {
+        to_col[i]+=col[i];
+    }
+}
+gain_row dense_gain::row(const full & mod, mwIndex node) const {
+    gain_row r;
+    r.row=G.data()+node;
+    r.col=mod.val+node*mod.m;
+    r.stride=n;
+    r.self=mod.get(node, node);
+    return r;
+}
+void dense_gain::release() {
+    std::vector<double>().swap(G);
+    n=0;
+    k=0;
+}
+
+//implement state_run
+state_run::state_run(mwIndex node_in, mwSize N_in, mwIndex first_in, mwIndex last_in) : node(node_in), N(N_in), first(first_in), last(last_in) {}
+bool state_run::contains(mwIndex i) const {
+    return (i%N==node)&&(i/N>=first)&&(i/N<=last);
+}
+
+//implement run_budget
+run_budget::run_budget() : has_deadline(false), max_passes(std::numeric_limits<double>::infinity()), passes(0), truncated(false) {}
+void run_budget::set(double seconds, double passes_in) {
+    has_deadline=seconds<1e9; //longer limits (including inf) are treated as no limit
+    if (has_deadline) {
+        deadline=std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds>0 ? seconds : 0));
+    }
+    max_passes=passes_in;
+    passes=0;
+    truncated=false;
+}
+void run_budget::start_pass() {
+    passes+=1;
+    if (passes>max_passes) {
+        truncated=true;
+    }
+}
+bool run_budget::expired() {
+    if (!truncated&&has_deadline&&std::chrono::steady_clock::now()>deadline) {
+        truncated=true;
+    }
+    return truncated;
+}
+
+//implement engine (seed depends on time and number of instances created so far)
+engine::engine() {
+    static std::atomic<unsigned int> n_instances(0);
+    std::seed_seq seed({(unsigned int)time(0), n_instances++});
+    generator.seed(seed);
+}
+
 //implement template functions
-template<class M> double move(group_index & g, mwIndex node, const M & mod){
-    set_type unique_groups=possible_moves(g, node, mod);
-    map_type mod_c=mod_change(g, mod, unique_groups, node);
+template<class M> double move(engine & e, mwIndex node, const M & mod){
+    group_index & g=e.group;
+    if (e.budget.expired()) {
+        return 0;
+    }
+    set_type & unique_groups=possible_moves(g, e.workspace, node, mod);
+    map_type & mod_c=mod_change(g, e.workspace, mod, unique_groups, node);
     
     //find best move
     double mod_max=0;
@@ -99,6 +317,7 @@ template<class M> double move(group_index & g, mwIndex node, const M & mod){
             group_move=*it;
         }
     }
+    e.workspace.clear(g, mod);
     
     //move current node to most optimal group
     if(mod_max>NUM_TOL){
@@ -108,23 +327,24 @@ template<class M> double move(group_index & g, mwIndex node, const M & mod){
     return d_step;
 }
 
-
-//set up random engine
-std::default_random_engine generator((unsigned int)time(0));
-
 //move node to random group increasing modularity
-template<class M> double moverand(group_index & g, mwIndex node, const M & mod){
-    set_type unique_groups=possible_moves(g, node, mod);
-    map_type mod_c=mod_change(g, mod, unique_groups, node);
+template<class M> double moverand(engine & e, mwIndex node, const M & mod){
+    group_index & g=e.group;
+    if (e.budget.expired()) {
+        return 0;
+    }
+    set_type & unique_groups=possible_moves(g, e.workspace, node, mod);
+    map_type & mod_c=mod_change(g, e.workspace, mod, unique_groups, node);
     
     //find modularity increasing moves
     move_list mod_pos=positive_moves(unique_groups, mod_c);
+    e.workspace.clear(g, mod);
     
     // move node to a random group that increases modularity
     double d_step=0;
     if (!mod_pos.first.empty()) {
         std::uniform_int_distribution<mwIndex> randindex(0,mod_pos.first.size()-1);
-        mwIndex randmove=randindex(generator);
+        mwIndex randmove=randindex(e.generator);
         g.move(node,mod_pos.first[randmove]);
         d_step=mod_pos.second[randmove];
     }
@@ -133,18 +353,23 @@ template<class M> double moverand(group_index & g, mwIndex node, const M & mod){
 
 
 //move to random group with probability proportional to increase in modularity
-template<class M> double moverandw(group_index & g, mwIndex node, const M & mod){
-    set_type unique_groups=possible_moves(g, node, mod);
-    map_type mod_c=mod_change(g, mod, unique_groups, node);
+template<class M> double moverandw(engine & e, mwIndex node, const M & mod){
+    group_index & g=e.group;
+    if (e.budget.expired()) {
+        return 0;
+    }
+    set_type & unique_groups=possible_moves(g, e.workspace, node, mod);
+    map_type & mod_c=mod_change(g, e.workspace, mod, unique_groups, node);
     
     //find modularity increasing moves
     move_list mod_pos=positive_moves(unique_groups, mod_c);
+    e.workspace.clear(g, mod);
     
     //move node to a random group that increases modularity with probability proportional to the increase
     double d_step=0;
     if (!mod_pos.first.empty()) {
         std::discrete_distribution<mwIndex> randindex(mod_pos.second.begin(),mod_pos.second.end());
-        mwIndex randmove=randindex(generator);
+        mwIndex randmove=randindex(e.generator);
         g.move(node,mod_pos.first[randmove]);
         d_step=mod_pos.second[randmove];
     }
@@ -152,4 +377,34 @@ template<class M> double moverandw(group_index & g, mwIndex node, const M & mod)
 }
 
 
+//gain for moving all copies in run jointly to each candidate group: the columns of the copies
+//are accumulated for each group (excluding entries within the run), the gain relative to the
+//current groups of the copies is corrected by the entries between copies in different groups
+template<class M, class C> move_list coupled_moves(engine & e, const state_run & run, const M & mod, C & col){
+    group_index & g=e.group;
+    move_workspace & w=e.workspace;
+    if (w.mod_c.size()<g.n_groups) {
+        w.resize(g.n_groups);
+    }
+    double current=0;
+    double internal=0;
+    for (mwIndex t=run.first; t<=run.last; ++t) {
+        mwIndex state=run.node+t*run.N;
+        mod.column(state, col);
+        coupled_gain(g, w, run, state, col, current, internal);
+    }
+    
+    move_list moves;
+    for (set_type::iterator it=w.targets.begin(); it!=w.targets.end(); ++it) {
+        double gain=w.mod_c[*it]-current+internal;
+        if (gain>NUM_TOL) {
+            moves.first.push_back(*it);
+            moves.second.push_back(gain);
+        }
+    }
+    w.clear();
+    return moves;
+}
+
+
 #endif /* defined(__group_handler__group_handler__) */
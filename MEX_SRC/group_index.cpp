@@ -32,19 +32,37 @@ using namespace std;
 
 group_index::group_index():n_nodes(0), n_groups(0){}
 
+//0-based group of each node from a matlab group vector of any class accepted by visit_numeric
+//(read through a typed view, without converting the vector to double first)
+struct group_reader{
+    group_reader(vector<mwIndex> & nodes) : nodes(nodes) {}
+    
+    template<class T> void operator()(const T * pr){
+        for (mwIndex i=0; i<nodes.size(); i++) {
+            if (!(pr[i]>=1)) {
+                mexErrMsgIdAndTxt("group_index:assign", "group indices need to be positive");
+            }
+            nodes[i]=(mwIndex) pr[i]-1;
+        }
+    }
+    
+    vector<mwIndex> & nodes;
+};
+
+static void read_groups(const mxArray * group_vec, vector<mwIndex> & nodes){
+    nodes.resize(mxGetM(group_vec)*mxGetN(group_vec));
+    group_reader reader(nodes);
+    if (mxIsSparse(group_vec)||!visit_numeric(group_vec, reader)) {
+        mexErrMsgIdAndTxt("group_index:assign", "group vector needs to be a full double, single, logical, int32 or uint32 array");
+    }
+}
+
 group_index::group_index(const mxArray *matrix){
-	mwSize m=mxGetM(matrix);
-	mwSize n=mxGetN(matrix);
-	n_nodes=m*n;
-	double * temp_nodes = mxGetPr(matrix);
-	
-	nodes.resize(n_nodes);
+	read_groups(matrix, nodes);
+	n_nodes=nodes.size();
 	nodes_iterator.resize(n_nodes);
-	for(mwIndex i=0; i<n_nodes; i++){
-		nodes[i]=(mwIndex) temp_nodes[i]-1;
-	}
 	
-	n_groups= * max_element(nodes.begin(),nodes.end())+1;
+	n_groups= n_nodes ? * max_element(nodes.begin(),nodes.end())+1 : 0;
     
 	groups.resize(n_groups);
 	
@@ -56,26 +74,37 @@ group_index::group_index(const mxArray *matrix){
 }
 
 group_index & group_index::operator=(const mxArray *group_vec){
-    mwSize m=mxGetM(group_vec);
-    mwSize n=mxGetN(group_vec);
-    n_nodes=m*n;
-    double * temp_nodes = mxGetPr(group_vec);
-    
     nodes.clear();
-    nodes.resize(n_nodes);
+    read_groups(group_vec, nodes);
+    n_nodes=nodes.size();
     nodes_iterator.clear();
     nodes_iterator.resize(n_nodes);
     
+    n_groups = n_nodes ? * max_element(nodes.begin(), nodes.end())+1 : 0;
+    
+    groups.clear();
+    groups.resize(n_groups);
+    
+    
     for (mwIndex i=0; i<n_nodes; i++) {
-        nodes[i]=(mwIndex) temp_nodes[i]-1;
+        groups[nodes[i]].push_back(i);
+        nodes_iterator[i]= --groups[nodes[i]].end();
     }
     
-    n_groups = * max_element(nodes.begin(), nodes.end())+1;
+    return *this;
+}
+
+group_index & group_index::operator=(const vector<mwIndex> & group_vec){
+    n_nodes=group_vec.size();
+    nodes=group_vec;
+    nodes_iterator.clear();
+    nodes_iterator.resize(n_nodes);
+    
+    n_groups = n_nodes ? * max_element(nodes.begin(), nodes.end())+1 : 0;
     
     groups.clear();
     groups.resize(n_groups);
     
-    
     for (mwIndex i=0; i<n_nodes; i++) {
         groups[nodes[i]].push_back(i);
         nodes_iterator[i]= --groups[nodes[i]].end();
@@ -109,22 +138,33 @@ void group_index::move(mwIndex node, mwIndex group){
 	nodes[node]=group;
 }
 
-void group_index::export_matlab(mxArray * & out){
-    //implements tidyconfig
-	out=mxCreateDoubleMatrix(n_nodes,1,mxREAL);
-	double * val=mxGetPr(out);
+//implements tidyconfig (groups are numbered in order of their first node)
+template<class T> static void tidy_groups(const group_index & g, T * val){
     //keep track of nodes that have already been assigned
-    vector<bool> track_move(n_nodes,true);
+    vector<bool> track_move(g.n_nodes,true);
     mwIndex g_n=1;
-	list<mwIndex>::iterator it;
-	for(mwIndex i=0; i<n_nodes; i++){
+	list<mwIndex>::const_iterator it;
+	for(mwIndex i=0; i<g.n_nodes; i++){
 		if(track_move[i]){
-			for(it=groups[nodes[i]].begin(); it !=groups[nodes[i]].end();it++){
-				val[*it]=g_n;
+			for(it=g.groups[g.nodes[i]].begin(); it !=g.groups[g.nodes[i]].end();it++){
+				val[*it]=(T) g_n;
                 track_move[*it]=false;
 			}
             g_n++;
 		}
-	}	
+	}
 }
 
+void group_index::export_matlab(mxArray * & out, mxClassID type){
+    if (type==mxUINT32_CLASS) {
+        if (n_nodes>UINT32_MAX) {
+            mexErrMsgIdAndTxt("group_index:export", "too many nodes for a uint32 group vector");
+        }
+        out=mxCreateNumericMatrix(n_nodes,1,mxUINT32_CLASS,mxREAL);
+        tidy_groups(*this, static_cast<std::uint32_t *>(mxGetData(out)));
+    }
+    else {
+        out=mxCreateDoubleMatrix(n_nodes,1,mxREAL);
+        tidy_groups(*this, mxGetPr(out));
+    }
+}
@@ -14,11 +14,16 @@
 //                      to the group it is assigned to (allows constant time moving of nodes)
 //
 //
-//      index(group): return matlab indeces of nodes in group
+//      index(group): return matlab indeces of nodes in group (the result is moved out, its
+//                    buffer is allocated once and can be exported directly)
 //
 //      move(node,group): move node to group
 //
-//      export_matlab(matlab_array): output group vector to matlab_a
+//      operator = (group_vec): assign from matlab group vector (full double, single, logical,
+//                              int32 or uint32, read without conversion copy) or from 0-based std::vector (the latter
+//                              does not use the MATLAB API and is thread safe)
+//
+//      export_matlab(matlab_array, type): output group vector to matlab_a (double or uint32)
 //
 //
 //  Last modified by Lucas Jeub on 25/07/2014
@@ -49,12 +54,14 @@ struct group_index{
 	group_index(const mxArray *matrix); //assign group index from matlab
     
     group_index & operator = (const mxArray * group_vec); //assign group index from matlab
+    
+    group_index & operator = (const std::vector<mwIndex> & group_vec); //assign group index from 0-based group vector
 		
 	full index(mwIndex group); //index of all nodes in group
 	
 	void move(mwIndex node, mwIndex group); //move node to group
 
-	void export_matlab(mxArray * & out); //output group vector to matlab
+	void export_matlab(mxArray * & out, mxClassID type=mxDOUBLE_CLASS); //output group vector to matlab (double or uint32)
 
 	mwSize n_nodes;
 	mwSize n_groups;
@@ -0,0 +1,95 @@
+//
+//  hungarian.cpp
+//  hungarian
+//
+//  Solves the rectangular linear assignment problem using the shortest augmenting path
+//  formulation of the Hungarian algorithm (O(n^2 m) for n<=m).
+//
+//
+// Version: 2.2.0
+
+#include "hungarian.h"
+
+#include <limits>
+
+using namespace std;
+
+//minimise cost for n<=m, cost(i,j) returns the cost of assigning row i to column j (1-based)
+template<class C> static vector<mwSignedIndex> min_assignment(const C & cost, mwSize n, mwSize m){
+    const double INF=numeric_limits<double>::infinity();
+    vector<double> u(n+1,0), v(m+1,0);
+    vector<mwIndex> p(m+1,0), way(m+1,0);
+    vector<double> minv(m+1);
+    vector<bool> used(m+1);
+    
+    for (mwIndex i=1; i<=n; ++i) {
+        //augment the matching with row i
+        p[0]=i;
+        mwIndex j0=0;
+        fill(minv.begin(), minv.end(), INF);
+        fill(used.begin(), used.end(), false);
+        do {
+            used[j0]=true;
+            mwIndex i0=p[j0];
+            mwIndex j1=0;
+            double delta=INF;
+            for (mwIndex j=1; j<=m; ++j) {
+                if (!used[j]) {
+                    double cur=cost(i0,j)-u[i0]-v[j];
+                    if (cur<minv[j]) {
+                        minv[j]=cur;
+                        way[j]=j0;
+                    }
+                    if (minv[j]<delta) {
+                        delta=minv[j];
+                        j1=j;
+                    }
+                }
+            }
+            for (mwIndex j=0; j<=m; ++j) {
+                if (used[j]) {
+                    u[p[j]]+=delta;
+                    v[j]-=delta;
+                }
+                else {
+                    minv[j]-=delta;
+                }
+            }
+            j0=j1;
+        } while (p[j0]!=0);
+        //unwind augmenting path
+        do {
+            mwIndex j1=way[j0];
+            p[j0]=p[j1];
+            j0=j1;
+        } while (j0!=0);
+    }
+    
+    vector<mwSignedIndex> assignment(n,-1);
+    for (mwIndex j=1; j<=m; ++j) {
+        if (p[j]!=0) {
+            assignment[p[j]-1]=j-1;
+        }
+    }
+    return assignment;
+}
+
+vector<mwSignedIndex> max_assignment(const vector<double> & weight, mwSize rows, mwSize cols){
+    if (rows==0||cols==0) {
+        return vector<mwSignedIndex>(rows,-1);
+    }
+    if (rows<=cols) {
+        return min_assignment([&](mwIndex i, mwIndex j){return -weight[(i-1)+(j-1)*rows];}, rows, cols);
+    }
+    else {
+        //solve transposed problem and invert the assignment
+        vector<mwSignedIndex> col_assignment=min_assignment([&](mwIndex j, mwIndex i){return -weight[(i-1)+(j-1)*rows];}, cols, rows);
+        vector<mwSignedIndex> assignment(rows,-1);
+        for (mwIndex j=0; j<cols; ++j) {
+            if (col_assignment[j]>=0) {
+                assignment[col_assignment[j]]=j;
+            }
+        }
+        return assignment;
+    }
+}
@@ -0,0 +1,30 @@
+//
+//  hungarian.h
+//  hungarian
+//
+//  Solves the rectangular linear assignment problem (maximum weight matching between the rows
+//  and columns of a dense weight matrix) using the shortest augmenting path formulation of
+//  the Hungarian algorithm. Does not use the MATLAB memory manager and is therefore safe to
+//  call from worker threads.
+//
+//      max_assignment(weight, rows, cols): weight is stored column-major (rows x cols), returns
+//                                          the assigned column for each row or -1 if the row
+//                                          is not assigned (only possible if rows > cols)
+//
+//
+// Version: 2.2.0
+
+#ifndef HUNGARIAN_H
+#define HUNGARIAN_H
+
+#include <vector>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+std::vector<mwSignedIndex> max_assignment(const std::vector<double> & weight, mwSize rows, mwSize cols);
+
+#endif
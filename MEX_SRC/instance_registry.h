@@ -0,0 +1,83 @@
+//
+//  instance_registry.h
+//  instance_registry
+//
+//  Keeps independent instances of the state of a mex function, referenced from matlab by an
+//  opaque uint64 handle:
+//
+//      create(): creates a new instance and returns its handle
+//
+//      destroy(handle): frees the instance (and all its memory)
+//
+//      select(nrhs, prhs): returns the instance given by the handle in prhs[1] and removes the
+//              handle from the input arguments, or returns the default instance if prhs[1] is
+//              not a handle (keeps the single-instance interface working)
+//
+//  All instances are freed when the mex function is cleared.
+//
+//
+// Version: 2.2.0
+
+#ifndef INSTANCE_REGISTRY_H
+#define INSTANCE_REGISTRY_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+
+template<class T> struct instance_registry {
+    instance_registry() : next_handle(1) {}
+    
+    static bool is_handle(const mxArray * h) {
+        return mxIsUint64(h)&&mxGetNumberOfElements(h)==1;
+    }
+    
+    mxArray * create() {
+        uint64_t handle=next_handle++;
+        instances[handle].reset(new T());
+        mxArray * out=mxCreateNumericMatrix(1, 1, mxUINT64_CLASS, mxREAL);
+        *static_cast<uint64_t *>(mxGetData(out))=handle;
+        return out;
+    }
+    
+    void destroy(const mxArray * h) {
+        if (!is_handle(h)||!instances.erase(*static_cast<const uint64_t *>(mxGetData(h)))) {
+            mexErrMsgIdAndTxt("instance_registry:handle", "invalid instance handle");
+        }
+    }
+    
+    T & get(const mxArray * h) {
+        typename std::unordered_map<uint64_t, std::unique_ptr<T> >::iterator it;
+        if (!is_handle(h)||(it=instances.find(*static_cast<const uint64_t *>(mxGetData(h))))==instances.end()) {
+            mexErrMsgIdAndTxt("instance_registry:handle", "invalid instance handle");
+        }
+        return *it->second;
+    }
+    
+    //args is used to hold the remaining input arguments if a handle is removed
+    T & select(int & nrhs, const mxArray ** & prhs, std::vector<const mxArray *> & args) {
+        if (nrhs>1&&is_handle(prhs[1])) {
+            T & instance=get(prhs[1]);
+            args.assign(prhs, prhs+nrhs);
+            args.erase(args.begin()+1);
+            prhs=args.data();
+            --nrhs;
+            return instance;
+        }
+        return default_instance;
+    }
+    
+    T default_instance;
+    std::unordered_map<uint64_t, std::unique_ptr<T> > instances;
+    uint64_t next_handle;
+};
+
+#endif
@@ -29,45 +29,76 @@ full::full(const full &matrix): m(matrix.m), n(matrix.n), export_flag(0) {
 	}
 }
 
+//move constructor (takes the buffer, matrix is left empty and only valid for assignment or destruction)
+full::full(full && matrix) noexcept: m(matrix.m), n(matrix.n), val(matrix.val), export_flag(matrix.export_flag) {
+    matrix.m=0;
+    matrix.n=0;
+    matrix.val=NULL;
+    matrix.export_flag=1;
+}
+
 //construct by size
 full::full(mwSize m_, mwSize n_): m(m_), n(n_), export_flag(0) {
 	val=(double *) mxCalloc(m*n,sizeof(double));
 }
 
+//wrap an external buffer of m*n values (memory is not freed)
+full::full(mwSize m_, mwSize n_, double * val_): m(m_), n(n_), val(val_), export_flag(1) {}
 
-//construct from mxArray (not save, useful for input arguments that are not modified, otherwise use operator = )
-full::full(const mxArray * matrix): m(mxGetM(matrix)), n(mxGetN(matrix)), export_flag(0){
+
+bool is_numeric_input(const mxArray * array){
+    if (mxIsComplex(array)) {
+        return false;
+    }
+    return mxIsDouble(array)||mxIsSingle(array)||mxIsLogical(array)||mxIsInt32(array)||mxIsUint32(array);
+}
+
+
+//dense copy of the values of a sparse input matrix of any accepted class into out (out is zero)
+struct scatter_values{
+    scatter_values(double * out, const mxArray * matrix) : out(out), m(mxGetM(matrix)), n(mxGetN(matrix)), row(mxGetIr(matrix)), col(mxGetJc(matrix)) {}
     
-    if (mxIsDouble(matrix)) {
-        if(mxIsSparse(matrix)){
-            //input is sparse
-            
-            //allocate memory (initialises to zero)
-            val=(double *) mxCalloc(m*n,sizeof(double));
-            
-            //get input values
-            mwSize *row=mxGetIr(matrix);
-            mwSize *col=mxGetJc(matrix);
-            double *pr=mxGetPr(matrix);
-            
-            //assign values
-            for(mwIndex j=0; j<n; j++){
-                for(mwIndex i=col[j]; i<col[j+1];i++){
-                    val[row[i]+j*m]=pr[i];
-                }
+    template<class T> void operator()(const T * pr){
+        for (mwIndex j=0; j<n; j++) {
+            for (mwIndex i=col[j]; i<col[j+1]; i++) {
+                out[row[i]+j*m]=(double) pr[i];
             }
         }
-        else{
-            //input is full
-            //get input
-            val= mxGetPr(matrix);
-            
-            export_flag=1;
-        }
     }
-    else{
+    
+    double * out;
+    mwSize m;
+    mwSize n;
+    const mwIndex * row;
+    const mwIndex * col;
+};
+
+
+//construct from mxArray (not save, useful for input arguments that are not modified, otherwise use operator = )
+//full double input is borrowed from matlab, other classes are converted once
+full::full(const mxArray * matrix): m(mxGetM(matrix)), n(mxGetN(matrix)), export_flag(0){
+    
+    if (!is_numeric_input(matrix)) {
         //wrong input
-        mexErrMsgIdAndTxt("full:constructor", "mxArray must be either full or sparse matrix");
+        mexErrMsgIdAndTxt("full:constructor", "mxArray must be a real double, single, logical, int32 or uint32 matrix");
+    }
+    if (mxIsSparse(matrix)) {
+        //input is sparse (allocate memory, initialises to zero)
+        val=(double *) mxCalloc(m*n,sizeof(double));
+        scatter_values scatter(val, matrix);
+        visit_numeric(matrix, scatter);
+    }
+    else if (mxIsDouble(matrix)) {
+        //input is full double
+        val=mxGetPr(matrix);
+        
+        export_flag=1;
+    }
+    else {
+        //input is full of another class
+        val=(double *) mxMalloc(m*n*sizeof(double));
+        numeric_copy copy(val, m*n);
+        visit_numeric(matrix, copy);
     }
 }
 
@@ -105,6 +136,7 @@ full & full::operator = (const full & matrix) {
         //allocate memory
         if (export_flag) {
             val=(double *) mxMalloc(m*n*sizeof(double));
+            export_flag=0;
         }
         else {
             val=(double *) mxRealloc(val,m*n*sizeof(double));
@@ -120,6 +152,26 @@ full & full::operator = (const full & matrix) {
 }
 
 
+//move assignment (frees owned memory and takes the buffer of matrix)
+full & full::operator = (full && matrix) noexcept {
+    if (this!= &matrix) {
+        if (!export_flag) {
+            mxFree(val);
+        }
+        m=matrix.m;
+        n=matrix.n;
+        val=matrix.val;
+        export_flag=matrix.export_flag;
+        
+        matrix.m=0;
+        matrix.n=0;
+        matrix.val=NULL;
+        matrix.export_flag=1;
+    }
+    return *this;
+}
+
+
 //convert from sparse
 full & full::operator = (const sparse & matrix){
     
@@ -130,6 +182,7 @@ full & full::operator = (const sparse & matrix){
     //allocate memory
     if (export_flag) {
         val=(double *) mxMalloc(m*n*sizeof(double));
+        export_flag=0;
     }
     else {
         val=(double *) mxRealloc(val, m*n*sizeof(double));
@@ -152,64 +205,38 @@ full & full::operator = (const sparse & matrix){
 //copy from mxArray
 full & full::operator = (const mxArray * matrix){
 	
+    if (!is_numeric_input(matrix)) {
+        //wrong input
+        mexErrMsgIdAndTxt("full:assignment", "mxArray must be a real double, single, logical, int32 or uint32 matrix");
+    }
+    
     //get size of input
     m=mxGetM(matrix);
 	n=mxGetN(matrix);
     mwSize total_size=m*n;
-    if (mxIsDouble(matrix)) {
-        
-        if(mxIsSparse(matrix)){
-            //input is sparse
-        
-            //allocate memory
-            if (export_flag) {
-                val=(double *) mxMalloc(total_size*sizeof(double));
-            }
-            else {
-                val=(double *) mxRealloc(val,total_size*sizeof(double));
-            }
-            //initialise to 0
-            for (mwIndex i=0; i<total_size; i++) {
-                val[i]=0;
-            }
-        
-            //get input values
-            mwIndex *row=mxGetIr(matrix);
-            mwIndex *col=mxGetJc(matrix);
-            double *pr=mxGetPr(matrix);
-		
-            //copy input values
-            for(mwIndex j=0; j<n; j++){
-                for(mwIndex i=col[j]; i<col[j+1];i++){
-                    val[row[i]+j*m]=pr[i];
-                }
-            }
-        }
-        else{
-            //input is full
-        
-            //get input values
-            double * val_in=mxGetPr(matrix);
-            
-            //allocate memory
-            if (export_flag) {
-                val=(double *) mxMalloc(total_size*sizeof(double));
-            }
-            else {
-                val=(double *) mxRealloc(val,total_size*sizeof(double));
-            }
-		
-            //copy values
-            
-            for(mwIndex i=0; i<total_size; i++){
-                val[i]=val_in[i];
-            }
+    
+    //allocate memory
+    if (export_flag) {
+        val=(double *) mxMalloc(total_size*sizeof(double));
+        export_flag=0;
+    }
+    else {
+        val=(double *) mxRealloc(val,total_size*sizeof(double));
+    }
+    
+    if(mxIsSparse(matrix)){
+        //input is sparse (initialise to 0)
+        for (mwIndex i=0; i<total_size; i++) {
+            val[i]=0;
         }
+        scatter_values scatter(val, matrix);
+        visit_numeric(matrix, scatter);
+    }
+    else{
+        //input is full
+        numeric_copy copy(val, total_size);
+        visit_numeric(matrix, copy);
     }
-	else{
-        //wrong input
-        mexErrMsgIdAndTxt("full:assignment", "mxArray must be either full or sparse matrix");
-	}
     
 	return *this;
 }
@@ -221,6 +248,7 @@ full & full::operator=(const std::vector<double> &vec) {
     
     if (export_flag) {
         val=(double *) mxMalloc(m*n*sizeof(double));
+        export_flag=0;
     }
     else {
         val=(double *) mxRealloc(val, m*n*sizeof(double));
@@ -362,6 +390,33 @@ full full::operator / (const full &B) {
 	return C;
 }
 
+void full::column(mwIndex j, full & out) const {
+    if ( !(j<n) ) {
+        mexErrMsgIdAndTxt("full:column", "index out of bounds");
+    }
+    if (out.m*out.n!=m) {
+        mexErrMsgIdAndTxt("full:column", "output column has wrong size");
+    }
+    const double * c=val+j*m;
+    for (mwIndex i=0; i<m; ++i) {
+        out.val[i]=c[i];
+    }
+}
+
+bool full::is_symmetric() const {
+    if (m!=n) {
+        return false;
+    }
+    for (mwIndex j=0; j<n; ++j) {
+        for (mwIndex i=j+1; i<m; ++i) {
+            if (val[i+j*m]!=val[j+i*m]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 //row iterator
 double & full::rowiterator::operator[](mwSignedIndex i) {
     mwSignedIndex c=(rowpos+i) % n;
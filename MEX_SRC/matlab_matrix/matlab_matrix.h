@@ -23,6 +23,7 @@
 #include <limits>
 #include <iterator>
 #include <vector>
+#include <cstdint>
 
 #include "mex.h"
 
@@ -32,10 +33,61 @@
 
 struct full;
 
+//true for the classes accepted as input for matrices and index vectors (real double, single,
+//logical, int32 or uint32)
+bool is_numeric_input(const mxArray * array);
+
+//calls f(data) with a typed pointer to the values of a real double, single, logical, int32 or
+//uint32 matlab array (a view of the matlab data, nothing is converted or copied) and returns
+//false for any other class. F needs a member template operator()(const T * data)
+template<class F> bool visit_numeric(const mxArray * array, F & f){
+    if (mxIsComplex(array)) {
+        return false;
+    }
+    switch (mxGetClassID(array)) {
+        case mxDOUBLE_CLASS:
+            f(static_cast<const double *>(mxGetData(array)));
+            return true;
+        case mxSINGLE_CLASS:
+            f(static_cast<const float *>(mxGetData(array)));
+            return true;
+        case mxLOGICAL_CLASS:
+            f(static_cast<const mxLogical *>(mxGetData(array)));
+            return true;
+        case mxINT32_CLASS:
+            f(static_cast<const std::int32_t *>(mxGetData(array)));
+            return true;
+        case mxUINT32_CLASS:
+            f(static_cast<const std::uint32_t *>(mxGetData(array)));
+            return true;
+        default:
+            return false;
+    }
+}
+
+//copies n values of any class accepted by visit_numeric into out (converted to double)
+struct numeric_copy{
+    numeric_copy(double * out, mwSize n) : out(out), n(n) {}
+    
+    template<class T> void operator()(const T * data){
+        for (mwIndex i=0; i<n; ++i) {
+            out[i]=(double) data[i];
+        }
+    }
+    
+    double * out;
+    mwSize n;
+};
+
+//sparse and full own their buffers (mxCalloc'd) unless they borrow matlab data, wrap external
+//buffers or have been exported. Moving transfers the buffers (and their ownership) without
+//copying, the moved-from matrix is left empty and owns nothing.
 struct sparse{
 	sparse();
 	sparse(mwSize m, mwSize n, mwSize nmax);
+    sparse(mwSize m, mwSize n, mwSize nmax, mwIndex * row, mwIndex * col, double * val); //wraps external buffers (not owned, not freed)
 	sparse(const sparse &matrix);
+    sparse(sparse && matrix) noexcept;
     sparse(const full & matrix);
 	sparse(const mxArray *matrix);
     sparse(const std::vector<double> & vec);
@@ -44,6 +96,8 @@ struct sparse{
 	
 	sparse & operator = (const sparse & matrix);
     
+    sparse & operator = (sparse && matrix) noexcept;
+    
     sparse & operator = (const full & matrix);
 	
 	sparse & operator = (const mxArray *matrix);
@@ -59,7 +113,13 @@ struct sparse{
 
 	mwSize nzero() const { return col[n];}
     
+    mwSize max_col_nzero() const; //maximum number of non-zero elements in a column
+    
     double get(mwIndex i, mwIndex j) const;
+    
+    void column(mwIndex j, sparse & out) const; //copy column j into out (out.nmax needs to be large enough)
+    
+    bool is_symmetric() const; //check symmetry without forming the transpose
 	
 	void export_matlab(mxArray * & out);
 	
@@ -73,13 +133,19 @@ struct sparse{
 	private:
 	
 	bool export_flag;
+    
+    void compress(const mxArray * matrix); //allocate and assign from a full input matrix
+    
+    std::vector<double> converted; //values of a borrowed logical matrix (indices are not copied)
 };
 
 
 struct full{
 	full();
 	full(mwSize m, mwSize n);
+    full(mwSize m, mwSize n, double * val); //wraps an external buffer (not owned, not freed)
 	full(const full &matrix);
+    full(full && matrix) noexcept;
 	full(const mxArray * matrix);
     full(const std::vector<double> & vec);
 	
@@ -89,6 +155,8 @@ struct full{
 	
 	full & operator = (const full & matrix);
     
+    full & operator = (full && matrix) noexcept;
+    
     full & operator = (const sparse & matrix);
 	
 	full & operator = (const mxArray * matrix);
@@ -102,6 +170,10 @@ struct full{
     double get(mwIndex i) const;
     double operator [] (mwIndex i) const;
     
+    void column(mwIndex j, full & out) const; //copy column j into out (out needs to be m x 1)
+    
+    bool is_symmetric() const;
+    
 	
 	full operator / (const sparse &B);
 	full operator / (const full &B);
@@ -156,4 +228,63 @@ public:
    };
 
 
+//read-only views of borrowed matlab data (real double only, nothing is allocated or copied, the
+//view is valid as long as the mxArray). Use these for inputs that are only read on per-column
+//paths, sparse and full accept other classes but convert them.
+struct sparse_view{
+    sparse_view(const mxArray * matrix) : m(mxGetM(matrix)), n(mxGetN(matrix)) {
+        if (!mxIsSparse(matrix)||!mxIsDouble(matrix)||mxIsComplex(matrix)) {
+            mexErrMsgIdAndTxt("sparse_view:constructor", "mxArray must be a real sparse double matrix");
+        }
+        row=mxGetIr(matrix);
+        col=mxGetJc(matrix);
+        val=mxGetPr(matrix);
+    }
+    
+    mwSize nzero() const { return col[n];}
+    
+    mwSize m;
+    mwSize n;
+    const mwIndex * row;
+    const mwIndex * col;
+    const double * val;
+};
+
+struct full_view{
+    full_view(const mxArray * matrix) : m(mxGetM(matrix)), n(mxGetN(matrix)) {
+        if (mxIsSparse(matrix)||!mxIsDouble(matrix)||mxIsComplex(matrix)) {
+            mexErrMsgIdAndTxt("full_view:constructor", "mxArray must be a real full double matrix");
+        }
+        val=mxGetPr(matrix);
+    }
+    
+    double get(mwIndex i, mwIndex j) const { return val[i+j*m];}
+    
+    mwSize m;
+    mwSize n;
+    const double * val;
+};
+
+
+//symmetric sparse matrix stored as its upper triangle (including the diagonal). Entries below the
+//diagonal are not stored, instead a row index of the strictly upper triangle gives access to
+//the implicit transposed part when assembling a column.
+struct symmetric_sparse{
+    symmetric_sparse(const mxArray * matrix); //borrows upper triangle from matlab (not copied)
+    
+    mwSize max_col_nzero() const; //maximum number of non-zero elements in a column of the full matrix
+    
+    double get(mwIndex i, mwIndex j) const;
+    
+    void column(mwIndex j, sparse & out) const; //assemble column j of the full matrix
+    
+    mwSize m;
+    mwSize n;
+    sparse upper;
+    
+    std::vector<mwIndex> row_start; //entries of row i of the strict upper triangle are row_start[i]..row_start[i+1]-1
+    std::vector<std::uint32_t> row_col; //column index of each entry in the row index (32-bit, 4 bytes per stored entry)
+};
+
+
 #endif
@@ -12,6 +12,9 @@
 
 #include "matlab_matrix.h"
 
+#include <algorithm>
+#include <utility>
+
 
 //default constructor
 sparse::sparse():m(0), n(0),nmax(0),row(NULL),val(NULL), export_flag(0){
@@ -41,6 +44,18 @@ sparse::sparse(const sparse &matrix): m(matrix.m), n(matrix.n), nmax(matrix.nmax
 }
 
 
+//move constructor (takes the buffers, matrix is left empty and only valid for assignment or destruction)
+sparse::sparse(sparse && matrix) noexcept: m(matrix.m), n(matrix.n), nmax(matrix.nmax), row(matrix.row), col(matrix.col), val(matrix.val), export_flag(matrix.export_flag), converted(std::move(matrix.converted)) {
+    matrix.m=0;
+    matrix.n=0;
+    matrix.nmax=0;
+    matrix.row=NULL;
+    matrix.col=NULL;
+    matrix.val=NULL;
+    matrix.export_flag=1;
+}
+
+
 //construct by size
 sparse::sparse(mwSize m_,mwSize n_,mwSize nmax_):m(m_), n(n_), nmax(nmax_), export_flag(0) {
     
@@ -50,8 +65,13 @@ sparse::sparse(mwSize m_,mwSize n_,mwSize nmax_):m(m_), n(n_), nmax(nmax_), expo
     val=(double *) mxCalloc(nmax, sizeof(double));
 }
 
+//wrap external buffers (row and val hold nmax elements, col n+1, memory is not freed)
+sparse::sparse(mwSize m_, mwSize n_, mwSize nmax_, mwIndex * row_, mwIndex * col_, double * val_):m(m_), n(n_), nmax(nmax_), row(row_), col(col_), val(val_), export_flag(1) {
+    col[0]=0;
+}
+
 //convert from full
-sparse::sparse(const full & matrix) {
+sparse::sparse(const full & matrix) : export_flag(0) {
     
     //copy size
     m=matrix.m;
@@ -88,62 +108,39 @@ sparse::sparse(const full & matrix) {
 
 
 //construct from mxArray (not save, useful for input arguments that are not modified, otherwise use operator = )
+//sparse double input is borrowed from matlab, sparse logical input borrows the index and converts
+//the values, full input of any accepted class is compressed without an intermediate double copy
 sparse::sparse(const mxArray * matrix): m(mxGetM(matrix)), n(mxGetN(matrix)), export_flag(0){
 	
-    if(mxIsDouble(matrix)){
-        if(mxIsSparse(matrix)){
-            //input is sparse
-            
-            nmax=mxGetNzmax(matrix);
-            row=mxGetIr(matrix);
+    if (!is_numeric_input(matrix)) {
+        //wrong input
+        mexErrMsgIdAndTxt("sparse:constructor", "mxArray must be a real double, single, logical, int32 or uint32 matrix");
+    }
+    if (mxIsSparse(matrix)) {
+        //input is sparse (double or logical)
+        nmax=mxGetNzmax(matrix);
+        row=mxGetIr(matrix);
+        col=mxGetJc(matrix);
+        if (mxIsDouble(matrix)) {
             val=mxGetPr(matrix);
-            col=mxGetJc(matrix);
-            
-            export_flag=1;
         }
-        else{
-            
-            //input is full
-            
-            //get input values
-            double *pr = mxGetPr(matrix);
-            
-            //find number of non-zero elements
-            nmax=0;
-            for(mwIndex i=0; i<m*n; i++){
-                if(pr[i]!=0){
-                    nmax++;
-                }
-            }
-            
-            //allocate memory
-            row=(mwIndex *) mxCalloc(nmax,sizeof(mwIndex));
-            col=(mwIndex *) mxCalloc(n+1, sizeof(mwIndex));
-            val=(double *) mxCalloc(nmax,sizeof(double));
-            
-            //assign values (c tracks number of non-zero elements used to assign appropriate values to col)
-            mwIndex c=0;
-            for(mwIndex j=0; j<n;j++){
-                col[j]=c;
-                for(mwIndex i=0; i<m; i++){
-                    if(pr[i+j*m]!=0){
-                        row[c]=i;
-                        val[c]=pr[i+j*m];
-                        c++;
-                    }
-                }
-            }
-            col[n]=c;
+        else {
+            converted.resize(nmax);
+            numeric_copy copy(converted.data(), col[n]);
+            visit_numeric(matrix, copy);
+            val=converted.data();
         }
-	}
-	else{
-        //wrong input
-        mexErrMsgIdAndTxt("sparse:constructor", "mxArray must be either full or sparse matrix");
+        
+        export_flag=1;
+    }
+    else {
+        //input is full
+        compress(matrix);
     }
 }
 
 //copy construct from vector<double>
-sparse::sparse(const std::vector<double> & vec) : m(vec.size()), n(1) {
+sparse::sparse(const std::vector<double> & vec) : m(vec.size()), n(1), export_flag(0) {
     nmax=0;
     for (std::vector<double>::const_iterator it=vec.begin(); it!=vec.end(); ++it) {
         if (*it!=0) {
@@ -194,6 +191,7 @@ sparse & sparse::operator = (const sparse & matrix){
             row=(mwIndex *) mxMalloc(nmax*sizeof(mwIndex));
             col=(mwIndex *) mxMalloc((n+1)*sizeof(mwIndex));
             val=(double *) mxMalloc(nmax*sizeof(double));
+            export_flag=0;
         }
         else {
             row=(mwIndex *) mxRealloc(row, nmax*sizeof(mwIndex));
@@ -218,6 +216,35 @@ sparse & sparse::operator = (const sparse & matrix){
 }
 
 
+//move assignment (frees owned memory and takes the buffers of matrix)
+sparse & sparse::operator = (sparse && matrix) noexcept {
+    if (this != &matrix) {
+        if (!export_flag) {
+            mxFree(row);
+            mxFree(col);
+            mxFree(val);
+        }
+        m=matrix.m;
+        n=matrix.n;
+        nmax=matrix.nmax;
+        row=matrix.row;
+        col=matrix.col;
+        val=matrix.val;
+        export_flag=matrix.export_flag;
+        converted=std::move(matrix.converted);
+        
+        matrix.m=0;
+        matrix.n=0;
+        matrix.nmax=0;
+        matrix.row=NULL;
+        matrix.col=NULL;
+        matrix.val=NULL;
+        matrix.export_flag=1;
+    }
+    return *this;
+}
+
+
 //convert from full
 sparse & sparse::operator=(const full &matrix){
     //copy size
@@ -237,6 +264,7 @@ sparse & sparse::operator=(const full &matrix){
         row=(mwIndex *) mxMalloc(nmax*sizeof(mwIndex));
         col=(mwIndex *) mxMalloc((n+1)*sizeof(mwIndex));
         val=(double *) mxMalloc(nmax*sizeof(double));
+        export_flag=0;
     }
     else {
         row=(mwIndex *) mxRealloc(row, nmax*sizeof(mwIndex));
@@ -265,91 +293,86 @@ sparse & sparse::operator=(const full &matrix){
 //copy from mxArray (full or sparse)
 sparse & sparse::operator = (const mxArray *matrix){
 	
+    if (!is_numeric_input(matrix)) {
+        mexErrMsgIdAndTxt("sparse:assignment", "mxArray must be a real double, single, logical, int32 or uint32 matrix");
+    }
+    
+    //free owned memory (borrowed or exported memory belongs to matlab)
+    if (!export_flag) {
+        mxFree(row);
+        mxFree(col);
+        mxFree(val);
+    }
+    export_flag=0;
+    std::vector<double>().swap(converted);
+    
     //get size of input
     m=mxGetM(matrix);
 	n=mxGetN(matrix);
 	
+    if(mxIsSparse(matrix)){
+        //input is sparse (double or logical)
+        nmax=mxGetNzmax(matrix);
+        row=(mwIndex *) mxCalloc(nmax,sizeof(mwIndex));
+        col=(mwIndex *) mxCalloc(n+1,sizeof(mwIndex));
+        val=(double *) mxCalloc(nmax,sizeof(double));
+        
+        //copy index and values
+        std::copy(mxGetIr(matrix), mxGetIr(matrix)+nmax, row);
+        std::copy(mxGetJc(matrix), mxGetJc(matrix)+n+1, col);
+        numeric_copy copy(val, col[n]);
+        visit_numeric(matrix, copy);
+    }
+    else{
+        //input is full
+        compress(matrix);
+    }
 	
-	if(mxIsDouble(matrix)){
-        if(mxIsSparse(matrix)){
-            //input is sparse
-            
-            //allocate memory
-            nmax=mxGetNzmax(matrix);
-            if (export_flag) {
-                row=(mwIndex *) mxMalloc(nmax*sizeof(mwIndex));
-                col=(mwIndex *) mxMalloc((n+1)*sizeof(mwIndex));
-                val=(double *) mxMalloc(nmax*sizeof(double));
-            }
-            else {
-                row=(mwIndex *) mxRealloc(row,nmax*sizeof(mwIndex));
-                col=(mwIndex *) mxRealloc(col,(n+1)*sizeof(mwIndex));
-                val=(double *) mxRealloc(val,nmax*sizeof(double));
-            }
-            
-            //get values of input matrix
-            mwIndex *row_in=mxGetIr(matrix);
-            mwIndex * col_in=mxGetJc(matrix);
-            double * val_in=mxGetPr(matrix);
-            
-            //copy row index and values
-            for(mwIndex i=0; i<nmax; i++){
-                row[i]=row_in[i];
-                val[i]=val_in[i];
-            }
-            
-            //copy column index
-            for(mwIndex i=0; i<=n; i++){
-                col[i]=col_in[i];
+	return *this;
+}
+
+//compressed copy of a full input matrix of any accepted class (allocates row, col and val)
+struct compress_values{
+    compress_values(sparse & out) : out(out) {}
+    
+    template<class T> void operator()(const T * pr){
+        mwSize m=out.m;
+        mwSize n=out.n;
+        
+        //find number of non-zero elements
+        out.nmax=0;
+        for (mwIndex i=0; i<m*n; i++) {
+            if (pr[i]!=0) {
+                out.nmax++;
             }
         }
-        else{
-            
-            //input is full
-            
-            //get input values
-            double *pr = mxGetPr(matrix);
-            
-            //find number of non-zero elements
-            nmax=0;
-            for(mwIndex i=0; i<m*n; i++){
-                if(pr[i]!=0){
-                    nmax++;
-                }
-            }
-            
-            //allocate memory
-            if (export_flag) {
-                row=(mwIndex *) mxMalloc(nmax*sizeof(mwIndex));
-                col=(mwIndex *) mxMalloc((n+1)*sizeof(mwIndex));
-                val=(double *) mxMalloc(nmax*sizeof(double));
-            }
-            else {
-                row=(mwIndex *) mxRealloc(row,nmax*sizeof(mwIndex));
-                col=(mwIndex *) mxRealloc(col,(n+1)*sizeof(mwIndex));
-                val=(double *) mxRealloc(val,nmax*sizeof(double));
-            }
-                
-            //assign values (c tracks number of non-zero elements used to assign appropriate values to col)
-            mwIndex c=0;
-            for(mwIndex j=0; j<n; j++){
-                col[j]=c;
-                for(mwIndex i=0; i<m;i++){
-                    if(pr[i+j*m]!=0){
-                        row[c]=i;
-                        val[c]=pr[i+j*m];
-                        c++;
-                    }
+        
+        //allocate memory
+        out.row=(mwIndex *) mxCalloc(out.nmax,sizeof(mwIndex));
+        out.col=(mwIndex *) mxCalloc(n+1, sizeof(mwIndex));
+        out.val=(double *) mxCalloc(out.nmax,sizeof(double));
+        
+        //assign values (c tracks number of non-zero elements used to assign appropriate values to col)
+        mwIndex c=0;
+        for (mwIndex j=0; j<n; j++) {
+            out.col[j]=c;
+            for (mwIndex i=0; i<m; i++) {
+                if (pr[i+j*m]!=0) {
+                    out.row[c]=i;
+                    out.val[c]=(double) pr[i+j*m];
+                    c++;
                 }
             }
-            col[n]=c;
         }
+        out.col[n]=c;
     }
-	else{
-        mexErrMsgIdAndTxt("sparse:assignment", "mxArray must be either full or sparse matrix");
-    }
-	
-	return *this;
+    
+    sparse & out;
+};
+
+void sparse::compress(const mxArray * matrix){
+    compress_values compressor(*this);
+    visit_numeric(matrix, compressor);
 }
 
 sparse & sparse::operator=(const std::vector<double> &vec) {
@@ -366,6 +389,7 @@ sparse & sparse::operator=(const std::vector<double> &vec) {
         row=(mwIndex *) mxCalloc(nmax,sizeof(mwIndex));
         col=(mwIndex *) mxCalloc(n+1,sizeof(mwIndex));
         val=(double *) mxCalloc(nmax, sizeof(double));
+        export_flag=0;
     }
     else {
         row=(mwIndex *) mxRealloc(row,nmax*sizeof(mwIndex));
@@ -504,7 +528,7 @@ double sparse::get(mwIndex i, mwIndex j) const {
     while((it<col[j+1])&&(row[it]<i)){
         it++;
     }
-    if (row[it]==i) {
+    if ((it<col[j+1])&&(row[it]==i)) {
         return val[it];
     }
     else{
@@ -512,3 +536,54 @@ double sparse::get(mwIndex i, mwIndex j) const {
     }
 }
 
+mwSize sparse::max_col_nzero() const {
+    mwSize nz_max=0;
+    for (mwIndex j=0; j<n; ++j) {
+        if (col[j+1]-col[j]>nz_max) {
+            nz_max=col[j+1]-col[j];
+        }
+    }
+    return nz_max;
+}
+
+void sparse::column(mwIndex j, sparse & out) const {
+    if ( !(j<n) ) {
+        mexErrMsgIdAndTxt("sparse:column", "Index out of bounds");
+    }
+    if (out.nmax<col[j+1]-col[j]) {
+        mexErrMsgIdAndTxt("sparse:column", "Output column too small");
+    }
+    mwIndex c=0;
+    for (mwIndex i=col[j]; i<col[j+1]; ++i) {
+        out.row[c]=row[i];
+        out.val[c]=val[i];
+        ++c;
+    }
+    out.m=m;
+    out.n=1;
+    out.col[0]=0;
+    out.col[1]=c;
+}
+
+//compares each element with its transposed element found by binary search in the corresponding
+//column (rows are sorted within columns), does not allocate memory
+bool sparse::is_symmetric() const {
+    if (m!=n) {
+        return false;
+    }
+    for (mwIndex j=0; j<n; ++j) {
+        for (mwIndex k=col[j]; k<col[j+1]; ++k) {
+            mwIndex i=row[k];
+            if (i!=j) {
+                const mwIndex * begin=row+col[i];
+                const mwIndex * end=row+col[i+1];
+                const mwIndex * pos=std::lower_bound(begin, end, j);
+                double val_t= (pos!=end&&*pos==j) ? val[pos-row] : 0;
+                if (val_t!=val[k]) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+//
+//  symmetric_sparse.cpp
+//  symmetric_sparse
+//
+//  Implements half-storage wrapper for symmetric sparse matlab matrices. Only the upper
+//  triangle (including the diagonal) is stored and borrowed from matlab. Columns of the full
+//  matrix combine the stored part of the column with the corresponding row of the upper
+//  triangle (found through a row index of the strictly upper triangle, which stores 32-bit
+//  column indeces to keep the overhead at 4 bytes per stored entry).
+//
+//
+
+#include "matlab_matrix.h"
+
+#include <algorithm>
+
+
+//construct from upper triangle of a sparse matlab matrix
+symmetric_sparse::symmetric_sparse(const mxArray * matrix) : m(mxGetM(matrix)), n(mxGetN(matrix)), upper(matrix) {
+    if (!mxIsSparse(matrix)) {
+        mexErrMsgIdAndTxt("symmetric_sparse:constructor", "upper triangle needs to be a sparse matrix");
+    }
+    if (m!=n) {
+        mexErrMsgIdAndTxt("symmetric_sparse:constructor", "matrix needs to be square");
+    }
+    if (n>((mwSize) std::numeric_limits<std::uint32_t>::max())+1) {
+        mexErrMsgIdAndTxt("symmetric_sparse:constructor", "matrix is too large for upper storage");
+    }
+    
+    //count entries in each row of the strict upper triangle
+    row_start.assign(n+1,0);
+    for (mwIndex j=0; j<n; ++j) {
+        for (mwIndex k=upper.col[j]; k<upper.col[j+1]; ++k) {
+            if (upper.row[k]>j) {
+                mexErrMsgIdAndTxt("symmetric_sparse:constructor", "matrix needs to be upper triangular");
+            }
+            if (upper.row[k]<j) {
+                ++row_start[upper.row[k]+1];
+            }
+        }
+    }
+    for (mwIndex i=0; i<n; ++i) {
+        row_start[i+1]+=row_start[i];
+    }
+    
+    //fill row index (column indeces are sorted within rows)
+    row_col.resize(row_start[n]);
+    std::vector<mwIndex> pos(row_start.begin(), row_start.end()-1);
+    for (mwIndex j=0; j<n; ++j) {
+        for (mwIndex k=upper.col[j]; k<upper.col[j+1]; ++k) {
+            if (upper.row[k]<j) {
+                row_col[pos[upper.row[k]]++]=(std::uint32_t) j;
+            }
+        }
+    }
+}
+
+
+mwSize symmetric_sparse::max_col_nzero() const {
+    mwSize nz_max=0;
+    for (mwIndex j=0; j<n; ++j) {
+        mwSize nz=upper.col[j+1]-upper.col[j]+row_start[j+1]-row_start[j];
+        if (nz>nz_max) {
+            nz_max=nz;
+        }
+    }
+    return nz_max;
+}
+
+
+double symmetric_sparse::get(mwIndex i, mwIndex j) const {
+    if (i>j) {
+        std::swap(i,j);
+    }
+    return upper.get(i,j);
+}
+
+
+void symmetric_sparse::column(mwIndex j, sparse & out) const {
+    if ( !(j<n) ) {
+        mexErrMsgIdAndTxt("symmetric_sparse:column", "Index out of bounds");
+    }
+    if (out.nmax<upper.col[j+1]-upper.col[j]+row_start[j+1]-row_start[j]) {
+        mexErrMsgIdAndTxt("symmetric_sparse:column", "Output column too small");
+    }
+    mwIndex c=0;
+    
+    //stored upper part (rows <= j)
+    for (mwIndex k=upper.col[j]; k<upper.col[j+1]; ++k) {
+        out.row[c]=upper.row[k];
+        out.val[c]=upper.val[k];
+        ++c;
+    }
+    
+    //implicit transposed part (rows > j), value of U(j,i) found by binary search in column i
+    for (mwIndex r=row_start[j]; r<row_start[j+1]; ++r) {
+        mwIndex i=row_col[r];
+        const mwIndex * begin=upper.row+upper.col[i];
+        const mwIndex * end=upper.row+upper.col[i+1];
+        const mwIndex * pos=std::lower_bound(begin, end, j);
+        out.row[c]=i;
+        out.val[c]=upper.val[pos-upper.row];
+        ++c;
+    }
+    out.m=m;
+    out.n=1;
+    out.col[0]=0;
+    out.col[1]=c;
+}
@@ -8,7 +8,18 @@
 //
 //  [output]=metanetwork_reduce('function_handle',input)
 //
-//  implemented functions are 'assign', 'move', 'return'
+//  [output]=metanetwork_reduce('function_handle',instance,input)
+//
+//  implemented functions are 'new', 'delete', 'assign', 'reduce', 'reduceblock', 'collect', 'matrix',
+//  'nodes', 'return'
+//
+//      new:    creates a new instance (with its own group structure and reduced column) and
+//              returns an opaque handle to it. All other functions take the handle as optional
+//              second argument (without handle, a default instance is used)
+//
+//
+//      delete: takes an instance handle as input and frees the instance
+//
 //
 //      assign: takes a group vector as input and uses it to initialise the "group_index"
 //
@@ -20,8 +31,32 @@
 //              matrix over all nodes in group i
 //
 //
+//      reduceblock: takes a block of columns X of the modularity matrix, the output column
+//              cols(j) for each column of X and the number of output columns k as input
+//
+//              returns the reduced columns (as for reduce), where output column c is the sum
+//              over all columns j of X with cols(j)==c (sparse if X is sparse, does not change
+//              the state of the instance)
+//
+//
+//      collect: takes a block of reduced columns (sparse or full, one row per group) as input and
+//              appends their non-zero entries as the next columns of the aggregated matrix that
+//              is built in compressed sparse column form inside the instance
+//
+//              returns the number of bytes of the collected matrix as a MATLAB sparse matrix
+//              (used to check the memory budget while the aggregated matrix is built)
+//
+//
+//      matrix: returns the collected columns as a sparse matrix and clears them (without
+//              output argument, the collected columns are discarded)
+//
+//
 //      nodes: takes a group and returns the matlab index of all nodes in this group
 //
+//              takes a vector of groups and returns the nodes of all groups and, as a second
+//              output, the position in the vector of the group of each node (used to request
+//              the columns of several groups at once for reduceblock)
+//
 //
 // Version: 2.2.0
 // Date: Thu 11 Jul 2019 12:25:43 CEST
@@ -31,21 +66,97 @@
 
 #include "matlab_matrix.h"
 #include "group_index.h"
+#include "instance_registry.h"
 #include <unordered_map>
 #include <cstring>
 #include <string>
+#include <algorithm>
 
 #ifndef OCTAVE
     #include "matrix.h"
 #endif
 
 using namespace std;
-static group_index group;
-static vector<double> mod_reduced=vector<double>();
-static bool return_sparse;
 
-enum func {ASSIGN, REDUCE, NODES, RETURN};
-static const unordered_map<string, func> function_switch({ {"assign", ASSIGN}, {"reduce", REDUCE}, {"nodes", NODES}, {"return", RETURN} });
+//state of an aggregation instance
+struct reduce_state {
+    reduce_state() : return_sparse(false), all_touched(false), coarse_col(1,0) {}
+    group_index group;
+    vector<double> mod_reduced;
+    bool return_sparse;
+    
+    //groups with a contribution since the last return (all groups once a full column is reduced),
+    //return only visits and resets these
+    vector<mwIndex> touched_rows;
+    vector<char> touched;
+    bool all_touched;
+    void touch(mwIndex r) {
+        if (!touched[r]) {
+            touched[r]=true;
+            touched_rows.push_back(r);
+        }
+    }
+    void clear_reduced() {
+        if (all_touched) {
+            mod_reduced.assign(mod_reduced.size(), 0);
+            touched.assign(touched.size(), false);
+        }
+        else {
+            for (vector<mwIndex>::iterator it=touched_rows.begin(); it!=touched_rows.end(); ++it) {
+                mod_reduced[*it]=0;
+                touched[*it]=false;
+            }
+        }
+        touched_rows.clear();
+        all_touched=false;
+        return_sparse=false;
+    }
+    
+    //aggregated matrix collected column by column (compressed sparse column form)
+    vector<mwIndex> coarse_col;
+    vector<mwIndex> coarse_row;
+    vector<double> coarse_val;
+    void clear_coarse() {
+        vector<mwIndex>(1,0).swap(coarse_col);
+        vector<mwIndex>().swap(coarse_row);
+        vector<double>().swap(coarse_val);
+    }
+    //size of the collected matrix as a MATLAB sparse matrix
+    double coarse_bytes() const {
+        return (double) (coarse_row.size()*(sizeof(mwIndex)+sizeof(double))+coarse_col.size()*sizeof(mwIndex));
+    }
+};
+
+static instance_registry<reduce_state> instances;
+
+//add a sparse column (sparse_view or sparse) to the reduced column
+template<class S> static void reduce_sparse(reduce_state & state, const S & mod){
+    if (mod.m!=state.group.n_nodes) {
+        mexErrMsgIdAndTxt("metanetwork_reduce:reduce:mod", "input modularity matrix has wrong size");
+    }
+    for (mwIndex i=0; i<mod.nzero(); i++) {
+        mwIndex r=state.group.nodes[mod.row[i]];
+        state.mod_reduced[r]+=mod.val[i];
+        state.touch(r);
+    }
+    state.return_sparse=true;
+}
+
+//add a full column (full_view or full) to the reduced column
+template<class F> static void reduce_full(reduce_state & state, const F & mod){
+    if (mod.m!=state.group.n_nodes) {
+        mexErrMsgIdAndTxt("metanetwork_reduce:reduce:mod", "input modularity matrix has wrong size");
+    }
+    for (mwIndex j=0; j<mod.n; ++j) {
+        for (mwIndex i=0; i<mod.m; ++i) {
+            state.mod_reduced[state.group.nodes[i]]+=mod.val[i+j*mod.m];
+        }
+    }
+    state.all_touched=true;
+}
+
+enum func {NEW_INSTANCE, DELETE_INSTANCE, ASSIGN, REDUCE, REDUCEBLOCK, COLLECT, MATRIX, NODES, RETURN};
+static const unordered_map<string, func> function_switch({ {"new", NEW_INSTANCE}, {"delete", DELETE_INSTANCE}, {"assign", ASSIGN}, {"reduce", REDUCE}, {"reduceblock", REDUCEBLOCK}, {"collect", COLLECT}, {"matrix", MATRIX}, {"nodes", NODES}, {"return", RETURN} });
 
 //metanetwork_reduce(handle, varargin)
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
@@ -63,7 +174,32 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
 
         //switch on handle
         if (function_switch.count(handle)>0) {
-            switch (function_switch.at(handle)) {
+            func f=function_switch.at(handle);
+            
+            //select instance (new and delete take no instance)
+            vector<const mxArray *> args;
+            reduce_state & state=(f==NEW_INSTANCE||f==DELETE_INSTANCE) ? instances.default_instance : instances.select(nrhs, prhs, args);
+            group_index & group=state.group;
+            vector<double> & mod_reduced=state.mod_reduced;
+            bool & return_sparse=state.return_sparse;
+            
+            switch (f) {
+                    
+                case NEW_INSTANCE: {
+                    if (nrhs!=1||nlhs!=1) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:new", "new needs no input and 1 output argument");
+                    }
+                    plhs[0]=instances.create();
+                    break;
+                }
+                    
+                case DELETE_INSTANCE: {
+                    if (nrhs!=2) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:delete", "delete needs 1 input argument");
+                    }
+                    instances.destroy(prhs[1]);
+                    break;
+                }
                     
                 case ASSIGN: {
                     //assign new group structure for aggregation
@@ -72,8 +208,12 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     }
                     group=prhs[1];
                     //zero out mod_reduced for next iteration
-                    mod_reduced=vector<double>(group.n_groups,0);
+                    mod_reduced.assign(group.n_groups,0);
+                    state.touched.assign(group.n_groups,false);
+                    state.touched_rows.clear();
+                    state.all_touched=false;
                     return_sparse=false;
+                    state.clear_coarse();
                     break;
                 }
                     
@@ -82,45 +222,207 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     if (nrhs!=2||nlhs!=0) {
                         mexErrMsgIdAndTxt("metanetwork_reduce:reduce", "reduce needs 1 input and no output argument");
                     }
-                    if (mxIsDouble(prhs[1])) {
-                        if (mxIsSparse(prhs[1])) { //sparse modularity input
-                            return_sparse=true;
-                            sparse mod_s(prhs[1]);
-                            if (mod_s.m==group.n_nodes) {
-                                for (mwIndex i=0; i<mod_s.nzero(); i++) {
-                                    mod_reduced[group.nodes[mod_s.row[i]]]+=mod_s.val[i];
+                    if (!is_numeric_input(prhs[1])) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:reduce:mod", "input modularity column needs to be a real double, single or logical array");
+                    }
+                    //double input is read through views, other classes are converted once
+                    if (mxIsSparse(prhs[1])) { //sparse modularity input
+                        if (mxIsDouble(prhs[1])) {
+                            reduce_sparse(state, sparse_view(prhs[1]));
+                        }
+                        else {
+                            reduce_sparse(state, sparse(prhs[1]));
+                        }
+                    }
+                    else {//full modularity input
+                        if (mxIsDouble(prhs[1])) {
+                            reduce_full(state, full_view(prhs[1]));
+                        }
+                        else {
+                            reduce_full(state, full(prhs[1]));
+                        }
+                    }
+                    break;
+                }
+                    
+                case REDUCEBLOCK: {
+                    //reduce a block of columns into k output columns
+                    if (nrhs!=4||nlhs!=1) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:reduceblock", "reduceblock needs 3 input and 1 output argument");
+                    }
+                    if (!is_numeric_input(prhs[1])||mxGetM(prhs[1])!=group.n_nodes||mxGetM(prhs[2])*mxGetN(prhs[2])!=mxGetN(prhs[1])) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:reduceblock:mod", "input modularity matrix has wrong size");
+                    }
+                    full cols(prhs[2]);
+                    mwSize k=(mwSize) mxGetScalar(prhs[3]);
+                    for (mwIndex j=0; j<cols.m*cols.n; ++j) {
+                        if (!(cols.get(j)>=1&&cols.get(j)<=k)) {
+                            mexErrMsgIdAndTxt("metanetwork_reduce:reduceblock", "output column out of bounds");
+                        }
+                    }
+                    if (mxIsSparse(prhs[1])) {
+                        sparse mod_s(prhs[1]);
+                        //input columns of each output column (counting sort)
+                        vector<mwIndex> start(k+1,0);
+                        for (mwIndex j=0; j<mod_s.n; ++j) {
+                            ++start[(mwIndex) cols.get(j)];
+                        }
+                        for (mwIndex c=0; c<k; ++c) {
+                            start[c+1]+=start[c];
+                        }
+                        vector<mwIndex> order(mod_s.n);
+                        vector<mwIndex> pos(start.begin(), start.end()-1);
+                        for (mwIndex j=0; j<mod_s.n; ++j) {
+                            order[pos[((mwIndex) cols.get(j))-1]++]=j;
+                        }
+                        //accumulate each output column in a dense work vector (only touched entries are reset)
+                        vector<double> acc(group.n_groups,0);
+                        vector<bool> touched(group.n_groups,false);
+                        vector<mwIndex> rows;
+                        vector<mwIndex> out_row;
+                        vector<double> out_val;
+                        vector<mwIndex> out_col(k+1,0);
+                        for (mwIndex c=0; c<k; ++c) {
+                            for (mwIndex o=start[c]; o<start[c+1]; ++o) {
+                                mwIndex j=order[o];
+                                for (mwIndex i=mod_s.col[j]; i<mod_s.col[j+1]; ++i) {
+                                    mwIndex r=group.nodes[mod_s.row[i]];
+                                    if (!touched[r]) {
+                                        touched[r]=true;
+                                        rows.push_back(r);
+                                    }
+                                    acc[r]+=mod_s.val[i];
                                 }
                             }
-                            else {
-                                mexErrMsgIdAndTxt("metanetwork_reduce:reduce:mod", "input modularity matrix has wrong size");
+                            sort(rows.begin(), rows.end());
+                            for (vector<mwIndex>::iterator it=rows.begin(); it!=rows.end(); ++it) {
+                                if (acc[*it]!=0) {
+                                    out_row.push_back(*it);
+                                    out_val.push_back(acc[*it]);
+                                }
+                                acc[*it]=0;
+                                touched[*it]=false;
                             }
+                            rows.clear();
+                            out_col[c+1]=out_row.size();
                         }
-                        else {//full modularity input
-                            full mod_d(prhs[1]);
-                            if (mod_d.m==group.n_nodes) {
-                                for (mwIndex i=0; i<group.n_groups; i++) {
-                                    for (list<mwIndex>::iterator it=group.groups[i].begin(); it!=group.groups[i].end(); ++it) {
-                                        for (full::rowiterator rit=mod_d.rowit(*it); rit!=mod_d.rowit(*it+1); ++rit) {
-                                            mod_reduced[i]+=*rit;
-                                        }
-                                    }
+                        sparse mod_out(group.n_groups, k, max(out_row.size(), (size_t) 1));
+                        copy(out_row.begin(), out_row.end(), mod_out.row);
+                        copy(out_val.begin(), out_val.end(), mod_out.val);
+                        copy(out_col.begin(), out_col.end(), mod_out.col);
+                        mod_out.export_matlab(plhs[0]);
+                    }
+                    else {
+                        full out(group.n_groups, k);
+                        full mod_d(prhs[1]);
+                        for (mwIndex j=0; j<mod_d.n; ++j) {
+                            double * out_col=out.colit(((mwIndex) cols.get(j))-1);
+                            for (mwIndex i=0; i<mod_d.m; ++i) {
+                                out_col[group.nodes[i]]+=mod_d.get(i,j);
+                            }
+                        }
+                        out.export_matlab(plhs[0]);
+                    }
+                    break;
+                }
+                    
+                case COLLECT: {
+                    //append reduced columns to the aggregated matrix
+                    if (nrhs!=2) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:collect", "collect needs 1 input argument");
+                    }
+                    if (!is_numeric_input(prhs[1])||mxGetM(prhs[1])!=group.n_groups) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:collect:mod", "reduced columns have wrong size");
+                    }
+                    if (state.coarse_col.size()-1+mxGetN(prhs[1])>group.n_groups) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:collect", "too many columns for the aggregated matrix");
+                    }
+                    if (mxIsSparse(prhs[1])) {
+                        sparse mod_s(prhs[1]);
+                        for (mwIndex j=0; j<mod_s.n; ++j) {
+                            for (mwIndex i=mod_s.col[j]; i<mod_s.col[j+1]; ++i) {
+                                if (mod_s.val[i]!=0) {
+                                    state.coarse_row.push_back(mod_s.row[i]);
+                                    state.coarse_val.push_back(mod_s.val[i]);
                                 }
                             }
-                            else {
-                                mexErrMsgIdAndTxt("metanetwork_reduce:reduce:mod", "input modularity matrix has wrong size");
+                            state.coarse_col.push_back(state.coarse_row.size());
+                        }
+                    }
+                    else {
+                        full mod_d(prhs[1]);
+                        for (mwIndex j=0; j<mod_d.n; ++j) {
+                            for (mwIndex i=0; i<mod_d.m; ++i) {
+                                if (mod_d.get(i,j)!=0) {
+                                    state.coarse_row.push_back(i);
+                                    state.coarse_val.push_back(mod_d.get(i,j));
+                                }
                             }
+                            state.coarse_col.push_back(state.coarse_row.size());
                         }
                     }
+                    if (nlhs>0) {
+                        plhs[0]=mxCreateDoubleScalar(state.coarse_bytes());
+                    }
+                    break;
+                }
+                    
+                case MATRIX: {
+                    //return the collected aggregated matrix and reset
+                    if (nrhs!=1) {
+                        mexErrMsgIdAndTxt("metanetwork_reduce:matrix", "matrix needs no input arguments");
+                    }
+                    if (nlhs>0) {
+                        mwSize n_cols=state.coarse_col.size()-1;
+                        sparse mod_out(group.n_groups, n_cols, max(state.coarse_row.size(), (size_t) 1));
+                        copy(state.coarse_row.begin(), state.coarse_row.end(), mod_out.row);
+                        copy(state.coarse_val.begin(), state.coarse_val.end(), mod_out.val);
+                        copy(state.coarse_col.begin(), state.coarse_col.end(), mod_out.col);
+                        state.clear_coarse();
+                        mod_out.export_matlab(plhs[0]);
+                    }
+                    else {
+                        state.clear_coarse();
+                    }
                     break;
                 }
                     
                 case NODES: {
-                    //return matlab indeces of nodes in group i
+                    //return matlab indeces of nodes in group i (or in a vector of groups)
                     if (nrhs!=2||nlhs<1) {
                         mexErrMsgIdAndTxt("metanetwork_reduce:nodes", "nodes needs 1 input and 1 output argument");
                     }
-                    full nodes=group.index(*mxGetPr(prhs[1])-1);
-                    nodes.export_matlab(plhs[0]);
+                    mwSize n_query=mxGetM(prhs[1])*mxGetN(prhs[1]);
+                    if (n_query==1&&nlhs==1) {
+                        full nodes=group.index((mwIndex) mxGetScalar(prhs[1])-1);
+                        nodes.export_matlab(plhs[0]);
+                    }
+                    else {
+                        full query(prhs[1]);
+                        mwSize n_nodes=0;
+                        for (mwIndex q=0; q<n_query; ++q) {
+                            mwIndex g=((mwIndex) query.get(q))-1;
+                            if ( !(g<group.n_groups) ) {
+                                mexErrMsgIdAndTxt("metanetwork_reduce:nodes", "group number out of bounds");
+                            }
+                            n_nodes+=group.groups[g].size();
+                        }
+                        full nodes(1,n_nodes);
+                        full position(1,n_nodes);
+                        mwIndex i=0;
+                        for (mwIndex q=0; q<n_query; ++q) {
+                            list<mwIndex> & members=group.groups[((mwIndex) query.get(q))-1];
+                            for (list<mwIndex>::iterator it=members.begin(); it!=members.end(); ++it) {
+                                nodes.get(i)=*it+1;
+                                position.get(i)=q+1;
+                                ++i;
+                            }
+                        }
+                        nodes.export_matlab(plhs[0]);
+                        if (nlhs>1) {
+                            position.export_matlab(plhs[1]);
+                        }
+                    }
                     break;
                 }
                     
@@ -129,19 +431,44 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
                     if (nrhs!=1|nlhs!=1) {
                         mexErrMsgIdAndTxt("metanetwork_reduce:return", "return needs 1 output argument and no input arguments");
                     }
+                    //the output is written directly into the exported buffers
                     if (return_sparse) {
-                        sparse mod_out=mod_reduced;
+                        vector<mwIndex> & rows=state.touched_rows;
+                        if (state.all_touched) {
+                            rows.resize(group.n_groups);
+                            for (mwIndex r=0; r<group.n_groups; ++r) {
+                                rows[r]=r;
+                            }
+                        }
+                        else {
+                            sort(rows.begin(), rows.end());
+                        }
+                        mwSize nzero=0;
+                        for (vector<mwIndex>::iterator it=rows.begin(); it!=rows.end(); ++it) {
+                            if (mod_reduced[*it]!=0) {
+                                ++nzero;
+                            }
+                        }
+                        sparse mod_out(group.n_groups, 1, max(nzero, (mwSize) 1));
+                        mwIndex c=0;
+                        for (vector<mwIndex>::iterator it=rows.begin(); it!=rows.end(); ++it) {
+                            if (mod_reduced[*it]!=0) {
+                                mod_out.row[c]=*it;
+                                mod_out.val[c]=mod_reduced[*it];
+                                ++c;
+                            }
+                        }
+                        mod_out.col[0]=0;
+                        mod_out.col[1]=c;
                         mod_out.export_matlab(plhs[0]);
                     }
                     else {
-                        full mod_out=mod_reduced;
+                        full mod_out(group.n_groups, 1);
+                        copy(mod_reduced.begin(), mod_reduced.end(), mod_out.val);
                         mod_out.export_matlab(plhs[0]);
                     }
                     //zero out mod_reduced for next iteration
-                    for (vector<double>::iterator it=mod_reduced.begin(); it!=mod_reduced.end(); ++it) {
-                        *it=0;
-                    }
-                    return_sparse=false;
+                    state.clear_reduced();
                     break;
                 }
                     
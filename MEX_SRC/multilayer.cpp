@@ -0,0 +1,307 @@
+//
+//  multilayer.cpp
+//  multilayer
+//
+//  Native kernels for multilayer partitions stored as N x T matrices.
+//
+//
+// Version: 2.2.0
+
+#include "multilayer.h"
+#include "hungarian.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+using namespace std;
+
+//label used for communities that are not matched to any community in another layer
+static const mwIndex NEW_LABEL=numeric_limits<mwIndex>::max();
+
+
+layer_partition::layer_partition() {}
+
+layer_partition::layer_partition(const mwIndex * S, mwSize N) : labels(S, S+N), local(N) {
+    sort(labels.begin(), labels.end());
+    labels.erase(unique(labels.begin(), labels.end()), labels.end());
+    for (mwIndex i=0; i<N; ++i) {
+        local[i]=lower_bound(labels.begin(), labels.end(), S[i])-labels.begin();
+    }
+}
+
+
+static bool label_less(const pair<mwIndex, mwIndex> & entry, mwIndex label) {
+    return entry.first<label;
+}
+
+mwIndex histogram_count(const label_histogram & h, mwIndex label) {
+    label_histogram::const_iterator it=lower_bound(h.begin(), h.end(), label, label_less);
+    if (it!=h.end()&&it->first==label) {
+        return it->second;
+    }
+    return 0;
+}
+
+void histogram_add(label_histogram & h, mwIndex label) {
+    label_histogram::iterator it=lower_bound(h.begin(), h.end(), label, label_less);
+    if (it!=h.end()&&it->first==label) {
+        ++(it->second);
+    }
+    else {
+        h.insert(it, make_pair(label, mwIndex(1)));
+    }
+}
+
+void histogram_remove(label_histogram & h, mwIndex label) {
+    label_histogram::iterator it=lower_bound(h.begin(), h.end(), label, label_less);
+    if (it!=h.end()&&it->first==label) {
+        if (--(it->second)==0) {
+            h.erase(it);
+        }
+    }
+}
+
+
+vector<mwIndex> read_partition(const full & S) {
+    mwSize n=S.m*S.n;
+    vector<mwIndex> labels(n);
+    for (mwIndex i=0; i<n; ++i) {
+        if (!(S[i]>=1)||S[i]!=floor(S[i])) {
+            mexErrMsgIdAndTxt("multilayer:partition", "partition needs to consist of positive integer labels");
+        }
+        labels[i]=(mwIndex) S[i]-1;
+    }
+    return labels;
+}
+
+
+void postprocess_ordinal(full & S, unsigned n_threads) {
+    mwSize N=S.m;
+    mwSize T=S.n;
+    if (T<2||N==0) {
+        return;
+    }
+    vector<mwIndex> labels=read_partition(S);
+    
+    //communities of each layer
+    vector<layer_partition> layers(T);
+    parallel_for(T, thread_count(n_threads, T), [&](mwIndex t, unsigned) {
+        layers[t]=layer_partition(labels.data()+t*N, N);
+    });
+    
+    //optimal assignment of the communities in layer t to the communities in layer t-1
+    //(independent of the relabeling of layer t-1 as relabeling is one-to-one)
+    vector<vector<mwSignedIndex> > match(T);
+    parallel_for(T-1, thread_count(n_threads, T-1), [&](mwIndex i, unsigned) {
+        const layer_partition & prev=layers[i];
+        const layer_partition & cur=layers[i+1];
+        mwSize k_cur=cur.labels.size();
+        mwSize k_prev=prev.labels.size();
+        
+        //node overlap between communities in the two layers
+        vector<double> overlap(k_cur*k_prev,0);
+        for (mwIndex v=0; v<N; ++v) {
+            overlap[cur.local[v]+prev.local[v]*k_cur]+=1;
+        }
+        vector<mwSignedIndex> assignment=max_assignment(overlap, k_cur, k_prev);
+        for (mwIndex j=0; j<k_cur; ++j) {
+            if (assignment[j]>=0&&overlap[j+assignment[j]*k_cur]==0) {
+                assignment[j]=-1;
+            }
+        }
+        match[i+1].swap(assignment);
+    });
+    
+    //apply relabeling (labels in first layer are unchanged, unmatched communities get new labels)
+    vector<mwIndex> new_labels=layers[0].labels;
+    mwIndex max_com=layers[0].labels.back();
+    for (mwIndex t=1; t<T; ++t) {
+        const layer_partition & cur=layers[t];
+        vector<mwIndex> next(cur.labels.size());
+        for (mwIndex j=0; j<next.size(); ++j) {
+            next[j]= match[t][j]>=0 ? new_labels[match[t][j]] : ++max_com;
+        }
+        for (mwIndex v=0; v<N; ++v) {
+            S[v+t*N]=next[cur.local[v]]+1;
+        }
+        new_labels.swap(next);
+    }
+}
+
+
+void postprocess_categorical(full & S, unsigned n_threads, default_random_engine & generator) {
+    mwSize N=S.m;
+    mwSize T=S.n;
+    if (N*T==0) {
+        return;
+    }
+    vector<mwIndex> labels=read_partition(S);
+    
+    //tidy labels
+    vector<mwIndex> unique_labels(labels);
+    sort(unique_labels.begin(), unique_labels.end());
+    unique_labels.erase(unique(unique_labels.begin(), unique_labels.end()), unique_labels.end());
+    for (vector<mwIndex>::iterator it=labels.begin(); it!=labels.end(); ++it) {
+        *it=lower_bound(unique_labels.begin(), unique_labels.end(), *it)-unique_labels.begin();
+    }
+    mwIndex max_com=unique_labels.size()-1;
+    
+    //labels of each node across all layers
+    vector<label_histogram> hist(N);
+    for (mwIndex t=0; t<T; ++t) {
+        for (mwIndex v=0; v<N; ++v) {
+            histogram_add(hist[v], labels[v+t*N]);
+        }
+    }
+    
+    vector<layer_partition> layers(T);
+    vector<vector<mwIndex> > targets(T);
+    vector<mwIndex> order(T);
+    for (mwIndex t=0; t<T; ++t) {
+        order[t]=t;
+    }
+    unsigned threads=thread_count(n_threads, T);
+    
+    bool improved=true;
+    while (improved) {
+        improved=false;
+        
+        //best assignment for each layer given the current labels of all other layers
+        parallel_for(T, threads, [&](mwIndex t, unsigned) {
+            const mwIndex * layer_labels=labels.data()+t*N;
+            layers[t]=layer_partition(layer_labels, N);
+            mwSize k=layers[t].labels.size();
+            
+            //labels that occur for the nodes of the layer in other layers
+            unordered_map<mwIndex, mwIndex> col_index;
+            vector<mwIndex> cols;
+            for (mwIndex v=0; v<N; ++v) {
+                for (label_histogram::const_iterator it=hist[v].begin(); it!=hist[v].end(); ++it) {
+                    if (it->second>(it->first==layer_labels[v]) && !col_index.count(it->first)) {
+                        col_index[it->first]=cols.size();
+                        cols.push_back(it->first);
+                    }
+                }
+            }
+            
+            //node overlap between communities in the layer and labels in other layers
+            vector<double> overlap(k*cols.size(),0);
+            for (mwIndex v=0; v<N; ++v) {
+                for (label_histogram::const_iterator it=hist[v].begin(); it!=hist[v].end(); ++it) {
+                    mwIndex count=it->second-(it->first==layer_labels[v]);
+                    if (count>0) {
+                        overlap[layers[t].local[v]+col_index[it->first]*k]+=count;
+                    }
+                }
+            }
+            vector<mwSignedIndex> assignment=max_assignment(overlap, k, cols.size());
+            targets[t].assign(k, NEW_LABEL);
+            for (mwIndex j=0; j<k; ++j) {
+                if (assignment[j]>=0&&overlap[j+assignment[j]*k]>0) {
+                    targets[t][j]=cols[assignment[j]];
+                }
+            }
+        });
+        
+        //apply assignments in random order if they still improve persistence
+        shuffle(order.begin(), order.end(), generator);
+        for (vector<mwIndex>::iterator ot=order.begin(); ot!=order.end(); ++ot) {
+            mwIndex t=*ot;
+            mwIndex * layer_labels=labels.data()+t*N;
+            const layer_partition & layer=layers[t];
+            const vector<mwIndex> & target=targets[t];
+            
+            //change in the number of agreements with other layers
+            mwSignedIndex gain=0;
+            for (mwIndex v=0; v<N; ++v) {
+                mwIndex new_label=target[layer.local[v]];
+                if (new_label!=NEW_LABEL) {
+                    gain+=histogram_count(hist[v], new_label)-(new_label==layer_labels[v]);
+                }
+                gain-=histogram_count(hist[v], layer_labels[v])-1;
+            }
+            
+            if (gain>0) {
+                improved=true;
+                vector<mwIndex> new_labels(target);
+                for (vector<mwIndex>::iterator it=new_labels.begin(); it!=new_labels.end(); ++it) {
+                    if (*it==NEW_LABEL) {
+                        *it=++max_com;
+                    }
+                }
+                for (mwIndex v=0; v<N; ++v) {
+                    histogram_remove(hist[v], layer_labels[v]);
+                    layer_labels[v]=new_labels[layer.local[v]];
+                    histogram_add(hist[v], layer_labels[v]);
+                }
+            }
+        }
+    }
+    
+    for (mwIndex i=0; i<N*T; ++i) {
+        S[i]=labels[i]+1;
+    }
+}
+
+
+double ordinal_agreements(const double * S, mwSize N, mwSize T, mwIndex begin, mwIndex end) {
+    double agree=0;
+    for (mwIndex t=1; t<T; ++t) {
+        const double * prev=S+(t-1)*N;
+        const double * cur=S+t*N;
+        for (mwIndex v=begin; v<end; ++v) {
+            agree+= prev[v]==cur[v];
+        }
+    }
+    return agree;
+}
+
+double categorical_agreements(const double * S, mwSize N, mwSize T, mwIndex begin, mwIndex end) {
+    //per-node label histogram, sum_c h(c)*(h(c)-1) counts ordered pairs of agreeing layers
+    unordered_map<double, mwIndex> hist;
+    double agree=0;
+    for (mwIndex v=begin; v<end; ++v) {
+        hist.clear();
+        for (mwIndex t=0; t<T; ++t) {
+            agree+=2*(hist[S[v+t*N]]++);
+        }
+    }
+    return agree;
+}
+
+double ordinal_persistence(const double * S, mwSize N, mwSize T) {
+    return ordinal_agreements(S, N, T, 0, N)/(N*(T-1.0));
+}
+
+double categorical_persistence(const double * S, mwSize N, mwSize T) {
+    return categorical_agreements(S, N, T, 0, N)/(N*T*(T-1.0));
+}
+
+vector<double> persistence(const vector<full> & partitions, bool categorical, unsigned n_threads) {
+    //split nodes of each partition into blocks if there are fewer partitions than threads
+    unsigned threads=thread_count(n_threads, numeric_limits<mwSize>::max());
+    mwSize n_blocks= partitions.size()<threads ? threads : 1;
+    mwSize n_tasks=partitions.size()*n_blocks;
+    vector<double> agree(n_tasks,0);
+    parallel_for(n_tasks, thread_count(n_threads, n_tasks), [&](mwIndex task, unsigned) {
+        const full & S=partitions[task/n_blocks];
+        mwIndex block=task%n_blocks;
+        mwSize block_size=(S.m+n_blocks-1)/n_blocks;
+        mwIndex begin=min(block*block_size, S.m);
+        mwIndex end=min(begin+block_size, S.m);
+        agree[task]= categorical ? categorical_agreements(S.val, S.m, S.n, begin, end) : ordinal_agreements(S.val, S.m, S.n, begin, end);
+    });
+    vector<double> pers(partitions.size(),0);
+    for (mwIndex i=0; i<partitions.size(); ++i) {
+        const full & S=partitions[i];
+        double pairs= categorical ? S.m*S.n*(S.n-1.0) : S.m*(S.n-1.0);
+        for (mwIndex b=0; b<n_blocks; ++b) {
+            pers[i]+=agree[i*n_blocks+b];
+        }
+        pers[i]/=pairs;
+    }
+    return pers;
+}
@@ -0,0 +1,87 @@
+//
+//  multilayer.h
+//  multilayer
+//
+//  Native kernels for multilayer partitions stored as N x T matrices (N nodes per layer,
+//  T layers, column t is the partition of layer t):
+//
+//      layer_partition: communities of a single layer (sorted unique labels and index of the
+//                       community of each node)
+//
+//      postprocess_ordinal(S, n_threads): relabels communities to maximise ordinal persistence
+//                                         without changing the partition of each layer. The
+//                                         optimal assignments for all pairs of consecutive
+//                                         layers are independent and solved in parallel, the
+//                                         resulting relabeling is applied in a single pass.
+//
+//      postprocess_categorical(S, n_threads, generator): relabels communities to improve
+//                                         categorical persistence. Assignments for all layers
+//                                         against the current labels of the remaining layers are
+//                                         solved in parallel and applied in random order if they
+//                                         still increase persistence. Stops once no layer can be
+//                                         improved.
+//
+//      ordinal_persistence(S, N, T), categorical_persistence(S, N, T): persistence of a
+//                                         multilayer partition (see ordinal_persistence.m and
+//                                         categorical_persistence.m) computed in O(N*T) by
+//                                         counting label agreements for each node directly
+//
+//      persistence(partitions, categorical, n_threads): persistence for a batch of
+//                                         multilayer partitions (processed in parallel)
+//
+//
+// Version: 2.2.0
+
+#ifndef MULTILAYER_H
+#define MULTILAYER_H
+
+#include <vector>
+#include <random>
+#include <utility>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+struct layer_partition{
+    layer_partition();
+    layer_partition(const mwIndex * S, mwSize N);
+    
+    std::vector<mwIndex> labels; //sorted unique labels of the layer
+    std::vector<mwIndex> local; //community of each node (index into labels)
+};
+
+//sorted (label, count) pairs for the labels of a node across layers
+typedef std::vector<std::pair<mwIndex, mwIndex> > label_histogram;
+
+mwIndex histogram_count(const label_histogram & h, mwIndex label);
+
+void histogram_add(label_histogram & h, mwIndex label);
+
+void histogram_remove(label_histogram & h, mwIndex label);
+
+//read partition with positive integer labels from matlab matrix (converts to 0-based labels)
+std::vector<mwIndex> read_partition(const full & S);
+
+void postprocess_ordinal(full & S, unsigned n_threads);
+
+void postprocess_categorical(full & S, unsigned n_threads, std::default_random_engine & generator);
+
+//number of pairs of consecutive layers (s,s+1) and nodes i with S(i,s)==S(i,s+1) for nodes [begin,end)
+double ordinal_agreements(const double * S, mwSize N, mwSize T, mwIndex begin, mwIndex end);
+
+//number of ordered pairs of distinct layers (s,t) and nodes i with S(i,s)==S(i,t) for nodes [begin,end)
+double categorical_agreements(const double * S, mwSize N, mwSize T, mwIndex begin, mwIndex end);
+
+double ordinal_persistence(const double * S, mwSize N, mwSize T);
+
+double categorical_persistence(const double * S, mwSize N, mwSize T);
+
+std::vector<double> persistence(const std::vector<full> & partitions, bool categorical, unsigned n_threads);
+
+#endif
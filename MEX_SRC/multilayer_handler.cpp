@@ -0,0 +1,155 @@
+//
+//  multilayer_handler.cpp
+//  multilayer_handler
+//
+// usage:
+//
+//  [output]=multilayer_handler('function_handle',input)
+//
+//  implemented functions are 'postprocess_ordinal', 'postprocess_categorical',
+//  'persistence_ordinal', 'persistence_categorical'
+//
+//      postprocess_ordinal: takes an N x T multilayer partition (and optionally the number of
+//              threads to use) as input
+//
+//              returns the partition with communities relabeled to maximise ordinal
+//              persistence without changing the partition of any layer (see
+//              postprocess_ordinal_multilayer.m)
+//
+//
+//      postprocess_categorical: takes an N x T multilayer partition (and optionally the number
+//              of threads to use) as input
+//
+//              returns the partition with communities relabeled to improve categorical
+//              persistence without changing the partition of any layer (see
+//              postprocess_categorical_multilayer.m)
+//
+//
+//      persistence_ordinal: takes an N x T multilayer partition or a cell of multilayer
+//              partitions (and optionally the number of threads to use) as input
+//
+//              returns the ordinal persistence of each partition (see ordinal_persistence.m)
+//
+//
+//      persistence_categorical: takes an N x T multilayer partition or a cell of multilayer
+//              partitions (and optionally the number of threads to use) as input
+//
+//              returns the categorical persistence of each partition (see
+//              categorical_persistence.m)
+//
+//
+// Version: 2.2.0
+
+
+#include "mex.h"
+
+#include "matlab_matrix.h"
+#include "multilayer.h"
+#include <unordered_map>
+#include <cstring>
+#include <string>
+#include <ctime>
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+using namespace std;
+
+static default_random_engine generator((unsigned int)time(0));
+
+enum func {POSTPROCESS_ORDINAL, POSTPROCESS_CATEGORICAL, PERSISTENCE_ORDINAL, PERSISTENCE_CATEGORICAL};
+static const unordered_map<string, func> function_switch({ {"postprocess_ordinal", POSTPROCESS_ORDINAL}, {"postprocess_categorical", POSTPROCESS_CATEGORICAL}, {"persistence_ordinal", PERSISTENCE_ORDINAL}, {"persistence_categorical", PERSISTENCE_CATEGORICAL} });
+
+//optional number of threads (0 uses all hardware threads)
+static unsigned get_threads(int nrhs, const mxArray *prhs[], int pos){
+    if (nrhs>pos) {
+        return (unsigned) mxGetScalar(prhs[pos]);
+    }
+    return 0;
+}
+
+//compute persistence for a single partition or a cell of partitions
+static void persistence_output(mxArray * & out, const mxArray * input, bool categorical, unsigned n_threads){
+    vector<full> partitions;
+    if (mxIsCell(input)) {
+        mwSize n=mxGetNumberOfElements(input);
+        partitions.reserve(n); //partitions borrow input memory and should not be copied
+        for (mwIndex i=0; i<n; ++i) {
+            partitions.emplace_back(mxGetCell(input, i));
+        }
+    }
+    else {
+        partitions.reserve(1);
+        partitions.emplace_back(input);
+    }
+    full pers=persistence(partitions, categorical, n_threads);
+    pers.export_matlab(out);
+}
+
+//multilayer_handler(handle, varargin)
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+    if (nrhs>0) {
+        //get handle to function to perform
+        mwSize strleng = mxGetM(prhs[0])*mxGetN(prhs[0])+1;
+        char * handle;
+        handle=(char *) mxCalloc(strleng, sizeof(char));
+        
+        if (mxGetString(prhs[0],handle,strleng)) {
+            mexErrMsgIdAndTxt("multilayer_handler:handle:string", "handle needs to be a string");
+        }
+        
+        //switch on handle
+        if (function_switch.count(handle)>0) {
+            switch (function_switch.at(handle)) {
+                    
+                case POSTPROCESS_ORDINAL: {
+                    if (nrhs<2||nrhs>3||nlhs!=1) {
+                        mexErrMsgIdAndTxt("multilayer_handler:postprocess_ordinal", "postprocess_ordinal needs 1 or 2 input and 1 output argument");
+                    }
+                    full S;
+                    S=prhs[1];
+                    postprocess_ordinal(S, get_threads(nrhs, prhs, 2));
+                    S.export_matlab(plhs[0]);
+                    break;
+                }
+                    
+                case POSTPROCESS_CATEGORICAL: {
+                    if (nrhs<2||nrhs>3||nlhs!=1) {
+                        mexErrMsgIdAndTxt("multilayer_handler:postprocess_categorical", "postprocess_categorical needs 1 or 2 input and 1 output argument");
+                    }
+                    full S;
+                    S=prhs[1];
+                    postprocess_categorical(S, get_threads(nrhs, prhs, 2), generator);
+                    S.export_matlab(plhs[0]);
+                    break;
+                }
+                    
+                case PERSISTENCE_ORDINAL: {
+                    if (nrhs<2||nrhs>3||nlhs!=1) {
+                        mexErrMsgIdAndTxt("multilayer_handler:persistence_ordinal", "persistence_ordinal needs 1 or 2 input and 1 output argument");
+                    }
+                    persistence_output(plhs[0], prhs[1], false, get_threads(nrhs, prhs, 2));
+                    break;
+                }
+                    
+                case PERSISTENCE_CATEGORICAL: {
+                    if (nrhs<2||nrhs>3||nlhs!=1) {
+                        mexErrMsgIdAndTxt("multilayer_handler:persistence_categorical", "persistence_categorical needs 1 or 2 input and 1 output argument");
+                    }
+                    persistence_output(plhs[0], prhs[1], true, get_threads(nrhs, prhs, 2));
+                    break;
+                }
+                    
+                default: {
+                    mexErrMsgIdAndTxt("multilayer_handler:switch","switch implementation error");
+                    break;
+                }
+            }
+        } else {
+            mexErrMsgIdAndTxt("multilayer_handler:handle", "invalid handle");
+        }
+    } else {
+        mexErrMsgIdAndTxt("multilayer_handler:handle", "need a handle to function");
+    }
+}
@@ -0,0 +1,69 @@
+//
+//  parallel.h
+//  parallel
+//
+//  Minimal thread pool for independent tasks:
+//
+//      thread_count(requested, n_tasks): number of worker threads to use (0 requests one thread
+//                                        per hardware thread)
+//
+//      parallel_for(n_tasks, n_threads, f): calls f(task, thread) for all tasks with dynamic
+//                                           scheduling, thread is the index of the worker thread
+//                                           (use for per-thread scratch space)
+//
+//  Tasks must not call the MATLAB API (mx*/mex* functions are not thread safe).
+//
+//
+// Version: 2.2.0
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+inline unsigned thread_count(unsigned requested, mwSize n_tasks){
+    unsigned n_threads=requested;
+    if (n_threads==0) {
+        n_threads=std::thread::hardware_concurrency();
+    }
+    if (n_threads==0) {
+        n_threads=1;
+    }
+    if (n_tasks<n_threads) {
+        n_threads=(unsigned) (n_tasks>0 ? n_tasks : 1);
+    }
+    return n_threads;
+}
+
+template<class F> void parallel_for(mwSize n_tasks, unsigned n_threads, F f){
+    if (n_threads<=1) {
+        for (mwIndex i=0; i<n_tasks; ++i) {
+            f(i,0u);
+        }
+        return;
+    }
+    std::atomic<mwIndex> next(0);
+    auto worker=[&](unsigned t){
+        for (mwIndex i=next++; i<n_tasks; i=next++) {
+            f(i,t);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t=1; t<n_threads; ++t) {
+        threads.emplace_back(worker,t);
+    }
+    worker(0);
+    for (std::vector<std::thread>::iterator it=threads.begin(); it!=threads.end(); ++it) {
+        it->join();
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+//
+//  quality.cpp
+//  quality
+//
+//  Evaluates the quality function for a batch of partitions in a single pass over the
+//  modularity matrix.
+//
+//
+// Version: 2.2.0
+
+#include "quality.h"
+#include "multilayer.h"
+
+using namespace std;
+
+//labels of each node for all partitions stored contiguously (read through a typed view)
+struct label_transpose{
+    label_transpose(vector<double> & labels, mwSize n_nodes, mwSize n_partitions) : labels(labels), n_nodes(n_nodes), n_partitions(n_partitions) {}
+    
+    template<class T> void operator()(const T * pr){
+        for (mwIndex k=0; k<n_partitions; ++k) {
+            for (mwIndex i=0; i<n_nodes; ++i) {
+                labels[i*n_partitions+k]=(double) pr[i+k*n_nodes];
+            }
+        }
+    }
+    
+    vector<double> & labels;
+    mwSize n_nodes;
+    mwSize n_partitions;
+};
+
+partition_batch::partition_batch(const mxArray * S) : n_nodes(mxGetM(S)), n_partitions(mxGetN(S)) {
+    labels.resize(n_nodes*n_partitions);
+    label_transpose transpose(labels, n_nodes, n_partitions);
+    if (mxIsSparse(S)||!visit_numeric(S, transpose)) {
+        mexErrMsgIdAndTxt("quality:partition", "partitions need to be a full double, single, logical, int32 or uint32 matrix");
+    }
+}
+
+
+void add_column_quality(const partition_batch & P, mwIndex j, const mwIndex * row, const double * val, mwSize nnz, mwIndex offset, double * Q) {
+    const double * label_j=P.node(j);
+    for (mwIndex i=0; i<nnz; ++i) {
+        const double * label_i=P.node(row[i]+offset);
+        for (mwIndex k=0; k<P.n_partitions; ++k) {
+            if (label_i[k]==label_j[k]) {
+                Q[k]+=val[i];
+            }
+        }
+    }
+}
+
+void add_column_quality(const partition_batch & P, mwIndex j, const double * col, mwSize m, mwIndex offset, double * Q) {
+    const double * label_j=P.node(j);
+    for (mwIndex i=0; i<m; ++i) {
+        if (col[i]!=0) {
+            const double * label_i=P.node(i+offset);
+            for (mwIndex k=0; k<P.n_partitions; ++k) {
+                if (label_i[k]==label_j[k]) {
+                    Q[k]+=col[i];
+                }
+            }
+        }
+    }
+}
+
+
+vector<double> quality(const partition_batch & P, const sparse & B) {
+    if (B.m!=P.n_nodes||B.n!=P.n_nodes) {
+        mexErrMsgIdAndTxt("quality:size", "modularity matrix and partitions have incompatible sizes");
+    }
+    vector<double> Q(P.n_partitions,0);
+    for (mwIndex j=0; j<B.n; ++j) {
+        add_column_quality(P, j, B.row+B.col[j], B.val+B.col[j], B.col[j+1]-B.col[j], 0, Q.data());
+    }
+    return Q;
+}
+
+vector<double> quality(const partition_batch & P, const full & B) {
+    if (B.m!=P.n_nodes||B.n!=P.n_nodes) {
+        mexErrMsgIdAndTxt("quality:size", "modularity matrix and partitions have incompatible sizes");
+    }
+    vector<double> Q(P.n_partitions,0);
+    for (mwIndex j=0; j<B.n; ++j) {
+        add_column_quality(P, j, B.val+j*B.m, B.m, 0, Q.data());
+    }
+    return Q;
+}
+
+//off-diagonal entries of the upper triangle count twice
+vector<double> quality(const partition_batch & P, const symmetric_sparse & B) {
+    if (B.m!=P.n_nodes||B.n!=P.n_nodes) {
+        mexErrMsgIdAndTxt("quality:size", "modularity matrix and partitions have incompatible sizes");
+    }
+    vector<double> Q(P.n_partitions,0);
+    for (mwIndex j=0; j<B.n; ++j) {
+        const double * label_j=P.node(j);
+        for (mwIndex i=B.upper.col[j]; i<B.upper.col[j+1]; ++i) {
+            const double * label_i=P.node(B.upper.row[i]);
+            double val= (B.upper.row[i]==j) ? B.upper.val[i] : 2*B.upper.val[i];
+            for (mwIndex k=0; k<P.n_partitions; ++k) {
+                if (label_i[k]==label_j[k]) {
+                    Q[k]+=val;
+                }
+            }
+        }
+    }
+    return Q;
+}
+
+vector<double> quality(const partition_batch & P, const mxArray * B) {
+    if (mxIsClass(B, "function_handle")) {
+        vector<double> Q(P.n_partitions,0);
+        mxArray * args[2];
+        args[0]=const_cast<mxArray *>(B);
+        args[1]=mxCreateDoubleScalar(0);
+        for (mwIndex j=0; j<P.n_nodes; ++j) {
+            //request column j
+            mxArray * col;
+            *mxGetPr(args[1])=j+1;
+            mexCallMATLAB(1, &col, 2, args, "feval");
+            if (mxGetM(col)!=P.n_nodes||mxGetN(col)!=1||!is_numeric_input(col)) {
+                mexErrMsgIdAndTxt("quality:column", "function handle needs to return a real (double, single or logical) column of the modularity matrix");
+            }
+            if (mxIsSparse(col)) {
+                sparse c(col);
+                add_column_quality(P, j, c.row, c.val, c.col[1]-c.col[0], 0, Q.data());
+            }
+            else {
+                full c(col);
+                add_column_quality(P, j, c.val, P.n_nodes, 0, Q.data());
+            }
+            mxDestroyArray(col);
+        }
+        mxDestroyArray(args[1]);
+        return Q;
+    }
+    else if (mxIsSparse(B)) {
+        return quality(P, sparse(B));
+    }
+    else {
+        return quality(P, full(B));
+    }
+}
+
+
+vector<double> multilayer_quality(const partition_batch & P, const mxArray * A, double omega, bool categorical) {
+    if (!mxIsCell(A)) {
+        mexErrMsgIdAndTxt("quality:multilayer", "intralayer modularity matrices need to be given as a cell");
+    }
+    mwSize T=mxGetNumberOfElements(A);
+    if (T==0||P.n_nodes%T!=0) {
+        mexErrMsgIdAndTxt("quality:size", "number of layers and partitions have incompatible sizes");
+    }
+    mwSize N=P.n_nodes/T;
+    vector<double> Q(P.n_partitions,0);
+    
+    //intralayer contributions
+    for (mwIndex s=0; s<T; ++s) {
+        const mxArray * layer=mxGetCell(A, s);
+        if (mxGetM(layer)!=N||mxGetN(layer)!=N) {
+            mexErrMsgIdAndTxt("quality:size", "intralayer modularity matrices need to be N x N");
+        }
+        if (mxIsSparse(layer)) {
+            sparse B(layer);
+            for (mwIndex j=0; j<N; ++j) {
+                add_column_quality(P, j+s*N, B.row+B.col[j], B.val+B.col[j], B.col[j+1]-B.col[j], s*N, Q.data());
+            }
+        }
+        else {
+            full B(layer);
+            for (mwIndex j=0; j<N; ++j) {
+                add_column_quality(P, j+s*N, B.val+j*N, N, s*N, Q.data());
+            }
+        }
+    }
+    
+    //interlayer contributions (each agreement corresponds to a pair of symmetric entries in
+    //the ordinal case and to a single ordered pair in the categorical case)
+    if (omega!=0) {
+        vector<double> S(N*T);
+        for (mwIndex k=0; k<P.n_partitions; ++k) {
+            for (mwIndex i=0; i<N*T; ++i) {
+                S[i]=P.node(i)[k];
+            }
+            if (categorical) {
+                Q[k]+=omega*categorical_agreements(S.data(), N, T, 0, N);
+            }
+            else {
+                Q[k]+=2*omega*ordinal_agreements(S.data(), N, T, 0, N);
+            }
+        }
+    }
+    return Q;
+}
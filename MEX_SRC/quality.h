@@ -0,0 +1,64 @@
+//
+//  quality.h
+//  quality
+//
+//  Evaluates the quality function Q(S) = sum_ij B(i,j) delta(S(i),S(j)) for a batch of
+//  partitions in a single pass over the modularity matrix:
+//
+//      partition_batch: labels of p partitions of n nodes (stored node-major so that the labels
+//                       of all partitions for a node are contiguous)
+//
+//      quality(P, B): quality of each partition for sparse or full B
+//
+//      quality(P, U): quality of each partition for a symmetric B stored as its upper triangle U
+//
+//      quality(P, B): quality of each partition for a function handle B such that B(j) returns
+//                     the jth column (each column is requested exactly once)
+//
+//      multilayer_quality(P, A, omega, categorical): quality for the multilayer modularity
+//                     matrix with intralayer matrices A{s} and uniform ordinal or categorical
+//                     coupling omega (coupling contribution is computed from label agreements)
+//
+//
+// Version: 2.2.0
+
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <vector>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+struct partition_batch{
+    partition_batch(const mxArray * S); //columns of S are partitions
+    
+    mwSize n_nodes;
+    mwSize n_partitions;
+    std::vector<double> labels;
+    
+    const double * node(mwIndex i) const {return labels.data()+i*n_partitions;}
+};
+
+//add contribution of column j (with rows offset by 'offset') to Q
+void add_column_quality(const partition_batch & P, mwIndex j, const mwIndex * row, const double * val, mwSize nnz, mwIndex offset, double * Q);
+
+void add_column_quality(const partition_batch & P, mwIndex j, const double * col, mwSize m, mwIndex offset, double * Q);
+
+std::vector<double> quality(const partition_batch & P, const sparse & B);
+
+std::vector<double> quality(const partition_batch & P, const full & B);
+
+std::vector<double> quality(const partition_batch & P, const symmetric_sparse & B);
+
+std::vector<double> quality(const partition_batch & P, const mxArray * B);
+
+std::vector<double> multilayer_quality(const partition_batch & P, const mxArray * A, double omega, bool categorical);
+
+#endif
@@ -0,0 +1,27 @@
+//
+//  reorder.cpp
+//  reorder
+//
+//  Implements locality improving node orders.
+//
+//
+// Version: 2.2.0
+
+#include "reorder.h"
+
+using namespace std;
+
+
+vector<mwIndex> interleave_order(mwSize n, mwSize T){
+    if (T==0||n%T!=0) {
+        mexErrMsgIdAndTxt("reorder:interleave", "number of nodes needs to be a multiple of the number of layers");
+    }
+    mwSize N=n/T;
+    vector<mwIndex> order(n);
+    for (mwIndex i=0; i<N; ++i) {
+        for (mwIndex s=0; s<T; ++s) {
+            order[i*T+s]=i+s*N;
+        }
+    }
+    return order;
+}
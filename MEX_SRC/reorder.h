@@ -0,0 +1,92 @@
+//
+//  reorder.h
+//  reorder
+//
+//  Locality improving node orders. All functions return a permutation p (0-based) such that
+//  node k of the reordered network is node p[k] of the original network:
+//
+//      bfs_order(B, cuthill_mckee): breadth-first search order of the sparsity pattern of B
+//              (starting each component from a node of minimum degree). With cuthill_mckee,
+//              neighbours are visited in order of increasing degree and the order is reversed
+//              (reverse Cuthill-McKee), which reduces the bandwidth of B.
+//
+//      interleave_order(n, T): interleaves the layers of a multilayer network with n/T nodes
+//              per layer stored as contiguous layer blocks, such that the copies of a node
+//              in different layers are adjacent.
+//
+//
+// Version: 2.2.0
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <vector>
+#include <algorithm>
+
+#include "mex.h"
+
+#ifndef OCTAVE
+    #include "matrix.h"
+#endif
+
+#include "matlab_matrix.h"
+
+
+std::vector<mwIndex> interleave_order(mwSize n, mwSize T);
+
+//M is sparse or symmetric_sparse
+template<class M> std::vector<mwIndex> bfs_order(const M & B, bool cuthill_mckee){
+    mwSize n=B.n;
+    sparse col(B.m, 1, B.max_col_nzero());
+    
+    //degree of each node (off-diagonal non-zeros)
+    std::vector<mwSize> degree(n,0);
+    for (mwIndex j=0; j<n; ++j) {
+        B.column(j, col);
+        for (mwIndex i=0; i<col.nzero(); ++i) {
+            if (col.row[i]!=j) {
+                ++degree[j];
+            }
+        }
+    }
+    
+    //start nodes in order of increasing degree
+    std::vector<mwIndex> start(n);
+    for (mwIndex j=0; j<n; ++j) {
+        start[j]=j;
+    }
+    std::stable_sort(start.begin(), start.end(), [&degree](mwIndex a, mwIndex b){return degree[a]<degree[b];});
+    
+    std::vector<mwIndex> order;
+    order.reserve(n);
+    std::vector<bool> visited(n,false);
+    for (mwIndex s=0; s<n; ++s) {
+        if (visited[start[s]]) {
+            continue;
+        }
+        visited[start[s]]=true;
+        order.push_back(start[s]);
+        //order doubles as the queue
+        for (mwIndex head=order.size()-1; head<order.size(); ++head) {
+            mwIndex node=order[head];
+            mwIndex first=order.size();
+            B.column(node, col);
+            for (mwIndex i=0; i<col.nzero(); ++i) {
+                if (!visited[col.row[i]]) {
+                    visited[col.row[i]]=true;
+                    order.push_back(col.row[i]);
+                }
+            }
+            if (cuthill_mckee) {
+                std::stable_sort(order.begin()+first, order.end(), [&degree](mwIndex a, mwIndex b){return degree[a]<degree[b];});
+            }
+        }
+    }
+    
+    if (cuthill_mckee) {
+        std::reverse(order.begin(), order.end());
+    }
+    return order;
+}
+
+#endif
@@ -1,4 +1,4 @@
-function [S,Q] = genlouvain(B,limit,verbose,randord,randmove,S0)
+function [S,Q,info] = genlouvain(B,limit,verbose,randord,randmove,S0,varargin)
 %GENLOUVAIN  Louvain-like community detection, specified quality function.
 %
 % Version: 2.2.0
@@ -29,11 +29,34 @@ function [S,Q] = genlouvain(B,limit,verbose,randord,randmove,S0)
 %   corresponding to the new aggregated network in subsequent passes. Use
 %   [S,Q] = GENLOUVAIN(B,limit) to change this default=10000 limit.
 %
+%   [S,Q] = GENLOUVAIN(D) with a struct D returned by MULTIASPECT with the
+%   'implicit' flag runs the first level without forming the interlayer
+%   coupling matrix: the engine generates the coupling between copies of a
+%   node from the aspect sizes, types and coupling strengths, and the
+%   aggregated network of the first level (at most the size of the first
+%   partition) is optimised as a sparse matrix B with the same options.
+%
+%   [S,Q] = GENLOUVAIN(D) with a struct D returned as third output of
+%   MODULARITYDIR_F, MULTIORDDIR_F or MULTICATDIR_F optimises the directed
+%   (Leicht-Newman) modularity natively: the engine tracks the in- and
+%   out-degree totals of each community in each layer, so that the gain of
+%   a move only needs the symmetrised adjacency matrix (no columns of the
+%   modularity matrix are formed, at any level). The same holds for the
+%   Barber modularity with D returned by BIPARTITE, BIPARTITE_F,
+%   MULTICATBIPARTITE(_F) or MULTIORDBIPARTITE(_F): the engine tracks the
+%   row-class and column-class degree totals of each community, such that
+%   the dense null model blocks between the two classes are never formed.
+%
 %   [S,Q] = GENLOUVAIN(B,limit,0) suppresses displayed text output.
 %
 %   [S,Q] = GENLOUVAIN(B,limit,verbose,0) forces index-ordered (cf.
 %   randperm-ordered) consideration of nodes, for deterministic results
-%   with randord = 'move'.
+%   with randord = 'move'. With randord = 'block', nodes are considered in
+%   a block-randomized order: blocks of consecutive nodes are visited in
+%   random order and nodes within each block are also visited in random
+%   order. This keeps nodes that are close in the node order (see the
+%   'reorder' option below) close in the visiting order, which improves
+%   memory locality, while still randomizing the order.
 %
 %   [S,Q]=GENLOUVAIN(B,limit,verbose,randord,randmove) controls additional
 %   randomization to obtain a broader sample of the quality function
@@ -65,6 +88,160 @@ function [S,Q] = genlouvain(B,limit,verbose,randord,randmove,S0)
 %   reshape S appropriate (e.g., reshape(S,N,T), where N is the number of
 %   nodes in each layer and T is the number of layers).
 %
+%   [S,Q] = GENLOUVAIN(B,limit,verbose,randord,randmove,S0,'Name',Value,...)
+%   sets additional options using name-value pairs. Available options are
+%       'storage': 'full' (default) or 'upper'. With 'upper', the
+%           symmetric modularity/quality matrix is given as its upper
+%           triangle, i.e., B=triu(Bsym) as a sparse matrix, which reduces
+%           the memory needed to store the matrix by about a third. The
+%           lower triangle is accessed implicitly and B is not symmetrised.
+%       'reorder': 'none' (default), 'rcm', 'bfs' or 'interleave'. Runs
+%           the algorithm on the network with nodes reordered to improve
+%           memory locality: 'rcm' uses a reverse Cuthill-McKee order and
+%           'bfs' a breadth-first search order of the sparsity pattern of B
+%           (B needs to be a sparse matrix), 'interleave' interleaves the
+%           layers of a multilayer network such that the copies of a node
+%           in different layers are adjacent (needs the 'layers' option).
+%           The output partition is returned in the original node order.
+%       'layers': number of layers T of a multilayer network where B has
+%           layer blocks of N=length(B)/T nodes (as generated by, e.g.,
+%           multiord or multicat). Used by 'reorder','interleave',
+%           'coupled' and 'layerblock'.
+%       'coupled': 'none' (default), 'ordinal' or 'categorical'. In
+%           addition to moving single nodes, moves the copies of each
+%           physical node in different layers jointly in the first level
+%           of the algorithm (needs the 'layers' option and a matrix B in
+%           the original node order). With 'ordinal', runs of copies in
+%           consecutive layers that are in the same community are moved
+%           together, with 'categorical' all copies of a node are moved to
+%           the same community. This reduces the number of passes and
+%           avoids poor local optima for strong interlayer coupling.
+%       'layerblock': number of consecutive layers per block (default []
+%           for no decomposition). Before the first pass, runs local
+%           moving independently (in parallel) on the diagonal block of B
+%           for each block of layers and uses the combined partition as
+%           the starting point of the passes on the full matrix B (needs
+%           the 'layers' option and a matrix B in the original node
+%           order). This is useful for weak interlayer coupling, where the
+%           problem is almost separable by layer. Communities of the
+%           starting partition (S0 or 'propagate') that extend across
+%           blocks keep their identity. Not used when resuming.
+%       'propagate': maximum number of label propagation iterations for the
+%           initial partition (default 0 for none). Before the first pass,
+%           runs label propagation (in parallel) on the positive part of B
+%           (or of the folded network), starting from S0: nodes repeatedly
+%           adopt the label with the largest total weight B(i,j)>0 among
+%           their neighbours. Interlayer coupling entries of a multilayer
+%           network are part of the positive part, so labels propagate
+%           along the copies of each node. The result has far fewer groups
+%           than singletons, which makes the first pass much cheaper, and
+%           is refined by the passes. Needs a matrix B, not used when
+%           resuming.
+%       'threads': number of threads for 'layerblock', 'components' and
+%           'propagate' (default 0 uses all hardware threads).
+%       'components': true or false (default). Finds the connected
+%           components of the positive part of B (B(i,j)>0). Entries
+%           between components are non-positive, so the quality function
+%           is separable and no community extends across components. If
+%           there is more than one component, runs the full algorithm
+%           independently for each component (in parallel, with small
+%           components batched together). Needs a sparse matrix B and a
+%           singleton initial partition. The 'limit', 'coupled',
+%           'layerblock' and 'checkpoint' options are not used in this
+%           case.
+%       'columnblock': block size for function handle input (default []
+%           requests one column per call). With block size b, the function
+%           handle B needs to accept a vector of indices idx and return the
+%           columns B(:,idx) (sparse or full). Columns are then requested in
+%           blocks of b columns, both for the passes and for building the
+%           columns of the aggregated networks, which amortises the cost of
+%           calling the function handle.
+%       'tiny': size threshold for the last levels (default 0 for none).
+%           Once the network of a level has at most this many nodes (at
+%           most 4096), all remaining levels are solved in a single call
+%           to group_handler on a dense copy of the network (local moving
+%           and aggregation without a MATLAB call per pass or level). With
+%           randmove 'move', a last level with at most 10 nodes is replaced
+%           by its optimal partition (exhaustive search). The remaining
+%           levels are recorded as a single level in info.hierarchy.
+%       'memory': memory budget in bytes for the aggregated networks of
+%           function handle input (default inf uses the 'limit' argument
+%           instead). After each level, the aggregated network is built as
+%           a sparse or full matrix, whichever is smaller (the size of the
+%           sparse matrix is estimated from the density of its first
+%           columns), if it fits into the budget, and is kept as a
+%           function handle otherwise. Replaces the 'limit' rule, which
+%           always builds a full matrix below the limit.
+%       'cachebytes': memory limit in bytes of a column cache for function
+%           handle input (default 0 for no cache). Columns returned by the
+%           function handle B (or by the function handle for the columns of
+%           an aggregated network) are kept in a cache inside group_handler
+%           and are not requested again in later passes of the same level.
+%           Once the limit is reached, least recently used columns are
+%           evicted. The cache is cleared at each level. Takes precedence
+%           over 'columnblock' for the passes.
+%       'gainsums': true or false (default). For a full matrix B (and
+%           the full aggregated matrices), keeps the node-to-community
+%           sums of B during each pass and updates them when a node moves,
+%           instead of accumulating the column of a node for every move.
+%           Building the sums costs an extra pass over B and up to 128 MB,
+%           so this only helps when many nodes move between few
+%           communities.
+%       'hierarchy': true or false (default). Records the partition and
+%           quality after each level in info.hierarchy (see below).
+%       'fold': 'none' (default), 'pendant' or 'all'. Heuristic reduction
+%           of the network before the first pass by merging nodes into
+%           super-nodes: with 'pendant', nodes with a single positive
+%           off-diagonal entry in B (degree-one nodes) are merged with their
+%           neighbour, with 'all', nodes with identical sets of positive
+%           neighbours are also merged. The algorithm runs on the aggregated
+%           matrix of the super-nodes (which gives the exact quality of the
+%           expanded partition) and the output partition is returned for the
+%           original nodes, but only partitions that keep super-nodes
+%           together are searched. 'pendant' is exact for standard
+%           modularity with gamma<=1 (some optimal partition then has every
+%           degree-one node in the community of its neighbour), for other
+%           quality matrices or gamma>1 it can exclude all optimal
+%           partitions.
+%           Merging twins with 'all' narrows the search space in general.
+%           Needs a sparse matrix B and a singleton initial partition and
+%           cannot be combined with 'coupled' or 'layerblock'.
+%       'randblock': size of the blocks for randord = 'block' (default
+%           256).
+%       'checkpoint': file name for checkpoints. The state of the run
+%           (current partition, aggregation map, coarse modularity matrix
+%           if it was built from a function handle, total change in quality
+%           and the state of the random number generator used for
+%           'moverand'/'moverandw') is written to this file after each
+%           aggregation step. The file is replaced atomically, such that it
+%           always contains a complete checkpoint.
+%       'resume': file name of a checkpoint to resume from. B and all
+%           options need to be the same as for the run that wrote the
+%           checkpoint. The visiting order after resuming depends on the
+%           state of the MATLAB random number generator, which is not part
+%           of the checkpoint.
+%       'maxtime': wall-clock budget in seconds (default inf).
+%       'maxpasses': maximum number of passes over the nodes (summed over
+%           all levels, default inf).
+%       When the budget is exhausted, the engine stops at the next node
+%           (also within a pass), and the partition found so far is
+%           returned with its quality.
+%
+%   [S,Q,info] = GENLOUVAIN(...) also returns a struct info with field
+%       'truncated': true if the run was stopped because the time or pass
+%           budget was exhausted, false if it converged.
+%       'hierarchy': (only with the option 'hierarchy',true) struct array
+%           with one element per aggregation level, where
+%           hierarchy(1).parent(i) is the community of node i after the
+%           first level and hierarchy(l).parent(c) is the community after
+%           level l of community c of level l-1 (so S is obtained by
+%           composing the parent arrays), and hierarchy(l).Q is the quality
+%           of the partition after level l. The quality of the
+%           intermediate levels is tracked from the changes in quality of
+%           the moves, which needs only one evaluation of the quality
+%           function for the initial partition. When resuming, the
+%           hierarchy starts from the resumed level.
+%
 %   Example (using adjacency matrix A)
 %         k = full(sum(A));
 %         twom = sum(k);
@@ -177,11 +354,6 @@ end
 if nargin<4||isempty(randord)
     randord = 1;
 end
-if randord
-    myord = @(n) randperm(n);
-else
-    myord = @(n) 1:n;
-end
 
 %set move function (maximal (original Louvain) or random improvement)
 if nargin<5||isempty(randmove)
@@ -207,6 +379,83 @@ if nargin<6||isempty(S0)
     S0=[];
 end
 
+% parse name-value options
+opts=parse_options(varargin{:});
+if ~any(strcmp(opts.storage,{'full','upper'}))
+    error('unknown value for ''storage''');
+end
+storage=opts.storage; % storage of the current modularity matrix M
+if ~any(strcmp(opts.reorder,{'none','rcm','bfs','interleave'}))
+    error('unknown value for ''reorder''');
+end
+if ~any(strcmp(opts.coupled,{'none','ordinal','categorical'}))
+    error('unknown value for ''coupled''');
+end
+if ~strcmp(opts.coupled,'none')
+    if isempty(opts.layers)
+        error('coupled moves need the number of layers (''layers'' option)');
+    end
+    if isa(B,'function_handle')||~strcmp(opts.reorder,'none')
+        error('coupled moves need a matrix B in the original node order');
+    end
+end
+if ~any(strcmp(opts.fold,{'none','pendant','all'}))
+    error('unknown value for ''fold''');
+end
+if ~strcmp(opts.fold,'none')
+    if isa(B,'function_handle')||~issparse(B)
+        error('''fold'' needs a sparse matrix B');
+    end
+    if ~strcmp(opts.coupled,'none')||~isempty(opts.layerblock)
+        error('''fold'' cannot be combined with ''coupled'' or ''layerblock''');
+    end
+end
+if opts.propagate>0&&isa(B,'function_handle')
+    error('''propagate'' needs a matrix B');
+end
+if ~isempty(opts.layerblock)
+    if isempty(opts.layers)
+        error('''layerblock'' needs the number of layers (''layers'' option)');
+    end
+    if isa(B,'function_handle')||~strcmp(opts.reorder,'none')
+        error('''layerblock'' needs a matrix B in the original node order');
+    end
+end
+
+%create engine instances for this run (freed on return or error, so that
+%several runs can be in progress at the same time)
+gh=group_handler('new');
+gh_cleanup=onCleanup(@() group_handler('delete',gh));
+mr=metanetwork_reduce('new');
+mr_cleanup=onCleanup(@() metanetwork_reduce('delete',mr));
+
+%set visiting order
+if ischar(randord)
+    if strcmp(randord,'block')
+        myord = @(n) block_randperm(n,opts.randblock);
+    else
+        error('unknown value for ''randord''');
+    end
+elseif randord
+    myord = @(n) randperm(n);
+else
+    myord = @(n) 1:n;
+end
+
+%multiaspect network with implicit interlayer coupling (multiaspect with
+%'implicit'), the first level is optimised without forming the coupling and
+%the aggregated network is passed on as a sparse matrix. Directed modularity
+%given as a struct (third output of modularitydir_f, multiorddir_f or
+%multicatdir_f), optimised from the adjacency and degrees
+if isstruct(B)&&isfield(B,'aspects')
+    run=@(M,time,passes) genlouvain(M,limit,verbose,randord,randmove,[],varargin{:},'maxtime',time,'maxpasses',passes);
+    [S,Q,info]=aspect_louvain(B,S0,gh,movefunction,myord,mydisp,opts,run);
+    return
+elseif isstruct(B)
+    [S,Q,info]=directed_louvain(B,S0,gh,movefunction,myord,mydisp,opts);
+    return
+end
+
 %initialise variables and do symmetry check
 if isa(B,'function_handle')
     n=length(B(1));
@@ -215,8 +464,8 @@ if isa(B,'function_handle')
         S0=(1:n)';
     else
         if numel(S0)==n
-            group_handler('assign',S0);
-            S0=group_handler('return'); % tidy config
+            group_handler('assign',gh,S0);
+            S0=group_handler('return',gh); % tidy config
         else
             error('Initial partition does not have the right size for the modularity matrix')
         end
@@ -233,6 +482,9 @@ if isa(B,'function_handle')
     if norm(full(it-it'))>2*eps
         error('Function handle does not correspond to a symmetric matrix. Deviation: %g', norm(full(it-it')))
     end
+    %storage option only applies to matrix input
+    opts.storage='full';
+    storage='full';
 else
     n = length(B);
     S = (1:n)';
@@ -241,41 +493,195 @@ else
     else
         if numel(S0)==n
             % clean input partition
-            group_handler('assign',S0);
-            S0=group_handler('return');
+            group_handler('assign',gh,S0);
+            S0=group_handler('return',gh);
         else
             error('Initial partition does not have the right size for the modularity matrix');
         end
     end
     %symmetry check and fix if not symmetric
-    if nnz(B-B')
+    if strcmp(storage,'upper')
+        if ~issparse(B)
+            error('''upper'' storage needs a sparse upper triangular matrix');
+        end
+    elseif ~group_handler('issymmetric',B)
         B=(B+B')/2; disp('WARNING: Forced symmetric B matrix')
     end
     M=B;
 end
 
+%reorder nodes to improve memory locality
+perm=[];
+if ~strcmp(opts.reorder,'none')
+    if strcmp(opts.reorder,'interleave')
+        if isempty(opts.layers)
+            error('''interleave'' needs the number of layers (''layers'' option)');
+        end
+        perm=group_handler('reorder','interleave',n,opts.layers);
+    elseif isa(B,'function_handle')
+        error('''%s'' reordering needs a sparse modularity matrix',opts.reorder);
+    else
+        perm=group_handler('reorder',opts.reorder,B,storage);
+    end
+    if isa(B,'function_handle')
+        B=@(i) permuted_column(M,perm,i);
+    else
+        B=B(perm,perm);
+        if strcmp(storage,'upper')
+            B=triu(B)+tril(B,-1).';
+        end
+    end
+    M=B;
+    S0=S0(perm);
+end
+
 dtot=eps; %keeps track of total change in modularity
+truncated=false; %set if the time or pass budget is exhausted
+if opts.hierarchy
+    hierarchy=struct('parent',{},'Q',{}); %partition and quality after each level
+else
+    hierarchy=[];
+end
 y = S0;
+S2 = [];
+coarse_B = false; %true if B is the aggregated matrix built from a function handle
+
+%resume from checkpoint
+if ~isempty(opts.resume)
+    state=group_handler('load',gh,opts.resume);
+    if state.n~=n
+        error('checkpoint does not match the size of the modularity matrix');
+    end
+    S=state.S;
+    y=state.y;
+    dtot=state.dtot;
+    mydisp(['Resuming from ',opts.resume]);
+    if strcmp(state.phase,'handle')
+        metanetwork_reduce('assign',mr,S);
+        M=@(i) metanetwork_i(B,i,mr,opts.columnblock);
+    else
+        if isfield(state,'B')
+            B=state.B;
+            coarse_B=true;
+        end
+        S2=state.S2;
+        if strcmp(opts.storage,'upper')&&~coarse_B
+            M = metanetwork_upper(B,S2);
+        else
+            M = metanetwork(B,S2);
+        end
+        storage='full';
+    end
+end
+%start time and pass budget
+group_handler('budget',gh,opts.maxtime,opts.maxpasses);
+
+%solve the components of the positive part of B independently (in parallel)
+if opts.components
+    if isa(B,'function_handle')||~issparse(B)
+        error('''components'' needs a sparse matrix B');
+    end
+    if ~isempty(opts.resume)||~isequal(y(:),(1:n)')
+        error('''components'' needs a singleton initial partition');
+    end
+    [c,nc]=group_handler('components',B,storage);
+    if nc>1
+        mydisp(['Solving ',num2str(nc),' components']);
+        S=group_handler('solvecomponents',gh,movefunction,B,c,...
+            ischar(randord)||logical(randord),storage,opts.threads);
+        truncated=group_handler('truncated',gh);
+        Q=group_handler('quality',B,S,storage);
+        hierarchy=record_level(hierarchy,S,S,Q);
+        info=run_info(truncated,hierarchy,false,Q,perm);
+        S=unpermute(S,perm);
+        return
+    end
+end
+
+%fold pendant (and equivalent) nodes into super-nodes, the passes below start
+%from the aggregated matrix of the super-nodes
+if ~strcmp(opts.fold,'none')&&isempty(opts.resume)
+    if ~isequal(y(:),(1:n)')
+        error('''fold'' needs a singleton initial partition');
+    end
+    [R,k]=group_handler('fold',B,opts.fold,storage);
+    if k<n
+        mydisp(['Folded ',num2str(n),' nodes into ',num2str(k),' super-nodes']);
+        S=R;
+        S2=R;
+        y=(1:k)';
+        if strcmp(storage,'upper')
+            M=metanetwork_upper(B,R);
+        else
+            M=metanetwork(B,R);
+        end
+        storage='full';
+    end
+end
+
+%label propagation on the positive part of the matrix for a cheap initial
+%partition with far fewer groups than singletons (refined by the passes below)
+if opts.propagate>0&&isempty(opts.resume)
+    group_handler('assign',gh,y);
+    y=group_handler('propagate',gh,M,opts.propagate,storage,opts.threads);
+    mydisp(['Label propagation: ',num2str(max(y)),' initial communities']);
+end
+
+%independent local moving on blocks of layers (in parallel), refined by the
+%passes on the full matrix below
+if ~isempty(opts.layerblock)&&isempty(opts.resume)
+    mydisp(['Local moving on blocks of ',num2str(opts.layerblock),' layers']);
+    group_handler('assign',gh,y);
+    dstep=group_handler('movelayers',gh,movefunction,myord(n),M,opts.layers,...
+        opts.layerblock,storage,opts.threads);
+    dtot=dtot+dstep;
+    y=group_handler('return',gh);
+    truncated=group_handler('truncated',gh);
+end
+
+%quality at the start of the passes (the quality after each level is tracked
+%from the total change dtot)
+if opts.hierarchy
+    Qstart=group_handler('quality',M,y,storage);
+    dstart=dtot;
+end
+
 %Run using function handle, if provided
 while (isa(M,'function_handle')) %loop around each "pass" (in language of Blondel et al) with B function handle
     clocktime=clock;
     mydisp(['Merging ',num2str(length(y)),' communities  ',datestr(clocktime)]);
+    if opts.cachebytes>0
+        group_handler('cache',gh,opts.cachebytes); %columns of the previous level are invalid
+    end
     Sb=S;
     yb=[];
     while ~isequal(yb,y)
         dstep=1;	%keeps track of change in modularity in pass
         yb=[];
-        while (~isequal(yb,y))&&(dstep/dtot>2*eps)&&(dstep>10*eps) %This is the loop around Blondel et al's "first phase"
+        while (~isequal(yb,y))&&(dstep/dtot>2*eps)&&(dstep>10*eps)&&~truncated %This is the loop around Blondel et al's "first phase"
             yb = y;
             dstep=0;
-            group_handler('assign',y);
-            for i=myord(length(M(1)))
-                di=group_handler(movefunction,i,M(i));
-                dstep=dstep+di;
+            group_handler('assign',gh,y);
+            if opts.cachebytes>0
+                %request columns not in the column cache
+                dstep=group_handler('movefn',gh,movefunction,myord(length(y)),M);
+            elseif isempty(opts.columnblock)
+                for i=myord(length(M(1)))
+                    di=group_handler(movefunction,gh,i,M(i));
+                    dstep=dstep+di;
+                end
+            else
+                %request columns in blocks
+                ord=myord(length(y));
+                for b=1:opts.columnblock:numel(ord)
+                    idx=ord(b:min(b+opts.columnblock-1,end));
+                    dstep=dstep+group_handler('moveblock',gh,movefunction,idx,M(idx));
+                end
             end
 
             dtot=dtot+dstep;
-            y=group_handler('return');
+            y=group_handler('return',gh);
+            truncated=group_handler('truncated',gh);
             mydisp([num2str(max(y)),' change: ',num2str(dstep),...
                 ' total: ',num2str(dtot),' relative: ',num2str(dstep/dtot)]);
         end
@@ -284,58 +690,102 @@ while (isa(M,'function_handle')) %loop around each "pass" (in language of Blonde
 
     %update partition
     S=y(S); %group_handler implements tidyconfig
+    if opts.hierarchy
+        hierarchy=record_level(hierarchy,S,y,Qstart+2*(dtot-dstart));
+    end
+    ylevel=y; %partition of the nodes of M (a truncated run can stop after moves)
     y = unique(y);  %unique also puts elements in ascending order
 
-    %calculate modularity and return if converged
-    if isequal(Sb,S)
-        Q=0;
-        P=sparse(y,1:length(y),1);
-        for i=1:length(M(1))
-            Q=Q+(P*M(i))'*P(:,i);
-        end
-        Q=full(Q);
-        clear('group_handler');
-        clear('metanetwork_reduce');
+    %calculate modularity and return if converged (or out of budget)
+    if isequal(Sb,S)||truncated
+        Q=group_handler('quality',M,ylevel);
+        info=run_info(truncated,hierarchy,isequal(Sb,S),Q,perm);
+        S=unpermute(S,perm);
         return
     end
 
-    %check wether #groups < limit
+    %check wether #groups < limit (or whether the aggregated network fits into
+    %the memory budget)
     t = length(unique(S));
-    if (t>limit)
-        metanetwork_reduce('assign',S); %inputs group information to metanetwork_reduce
-        M=@(i) metanetwork_i(B,i); %use function handle if #groups>limit
-    else
-        metanetwork_reduce('assign',S);
-        J = zeros(t);   %convert to matrix if #groups small enough
-        for c=1:t
-            J(:,c)=metanetwork_i(B,c);
+    metanetwork_reduce('assign',mr,S); %inputs group information to metanetwork_reduce
+    if isinf(opts.memory)
+        if t>limit
+            J=[];
+        else
+            J=zeros(t); %convert to matrix if #groups small enough
+            if isempty(opts.columnblock)
+                for c=1:t
+                    J(:,c)=metanetwork_i(B,c,mr);
+                end
+            else
+                for c=1:opts.columnblock:t
+                    idx=c:min(c+opts.columnblock-1,t);
+                    J(:,idx)=metanetwork_i(B,idx,mr,opts.columnblock);
+                end
+            end
         end
+    else
+        J=coarse_matrix(B,t,mr,opts.columnblock,opts.memory);
+    end
+    if isempty(J)
+        M=@(i) metanetwork_i(B,i,mr,opts.columnblock); %use function handle if #groups>limit
+        save_checkpoint(gh,opts.checkpoint,struct('phase','handle','n',n,'S',S,'y',y,'dtot',dtot));
+    else
         B = J;
         M=B;
+        coarse_B=true;
+        save_checkpoint(gh,opts.checkpoint,struct('phase','matrix','n',n,'S',S,'S2',(1:t)','y',y,'dtot',dtot,'B',B));
     end
 end
 
 % Run using matrix B
-S2 = (1:length(B))';
+if isempty(S2)
+    S2 = (1:length(B))';
+end
 Sb = [];
 while ~isequal(Sb,S2) %loop around each "pass" (in language of Blondel et al) with B matrix
     clocktime=clock;
     mydisp(['Merging ',num2str(max(y)),' communities  ',datestr(clocktime)]);
 
+    if length(M)<=min(opts.tiny,4096)&&~truncated&&(strcmp(opts.coupled,'none')||length(M)<n)
+        %solve all remaining levels inside group_handler
+        group_handler('assign',gh,y);
+        [y,dstep]=group_handler('solvetiny',gh,movefunction,M,...
+            ischar(randord)||logical(randord),storage);
+        dtot=dtot+dstep;
+        truncated=group_handler('truncated',gh);
+        S=y(S);
+        S2=y(S2);
+        if opts.hierarchy
+            hierarchy=record_level(hierarchy,S,y,Qstart+2*(dtot-dstart));
+        end
+        Q=group_handler('quality',M,y,storage);
+        info=run_info(truncated,hierarchy,~truncated,Q,perm);
+        S=unpermute(S,perm);
+        return
+    end
+
     Sb = S2;
     yb = [];
     while ~isequal(yb,y)
         dstep=1;
-        while (~isequal(yb,y)) && (dstep/dtot>2*eps) && (dstep>10*eps) %This is the loop around Blondel et al's "first phase"
+        while (~isequal(yb,y)) && (dstep/dtot>2*eps) && (dstep>10*eps) && ~truncated %This is the loop around Blondel et al's "first phase"
             yb = y;
-            dstep=0;
-            group_handler('assign',y);
-            for i = myord(length(M))
-                di=group_handler(movefunction,i,M(:,i));
-                dstep=dstep+di;
+            group_handler('assign',gh,y);
+            if opts.gainsums
+                %keep the node-to-group sums of a full M for the pass
+                dstep=group_handler('moveall',gh,movefunction,myord(length(M)),M,storage,'gain');
+            else
+                dstep=group_handler('moveall',gh,movefunction,myord(length(M)),M,storage);
+            end
+            if ~strcmp(opts.coupled,'none')&&length(M)==n
+                %joint moves of the copies of each node (first level only)
+                dstep=dstep+group_handler('movecoupled',gh,movefunction,...
+                    myord(n/opts.layers),M,opts.layers,opts.coupled,storage);
             end
             dtot=dtot+dstep;
-            y=group_handler('return');
+            y=group_handler('return',gh);
+            truncated=group_handler('truncated',gh);
 
             mydisp([num2str(max(y)),' change: ',num2str(dstep),...
                 ' total: ',num2str(dtot),' relative: ',num2str(dstep/dtot)]);
@@ -346,15 +796,30 @@ while ~isequal(Sb,S2) %loop around each "pass" (in language of Blondel et al) wi
     %update partition
     S=y(S);
     S2=y(S2);
+    if opts.hierarchy
+        hierarchy=record_level(hierarchy,S,y,Qstart+2*(dtot-dstart));
+    end
 
-    if isequal(Sb,S2)
-        P=sparse(y,1:length(y),1);
-        Q=full(sum(sum((P*M).*P)));
+    if isequal(Sb,S2)||truncated
+        Q=group_handler('quality',M,y,storage);
+        info=run_info(truncated,hierarchy,isequal(Sb,S2),Q,perm);
+        S=unpermute(S,perm);
         return
     end
 
-    M = metanetwork(B,S2);
+    if strcmp(opts.storage,'upper')
+        M = metanetwork_upper(B,S2);
+    else
+        M = metanetwork(B,S2);
+    end
+    storage = 'full';
     y = unique(S2);  %unique also puts elements in ascending order
+
+    state=struct('phase','matrix','n',n,'S',S,'S2',S2,'y',y,'dtot',dtot);
+    if coarse_B
+        state.B=B;
+    end
+    save_checkpoint(gh,opts.checkpoint,state);
 end
 
 end
@@ -367,12 +832,351 @@ M = PP'*J*PP;
 end
 
 %-----%
-function Mi = metanetwork_i(J,i)
+function M = metanetwork_upper(J,S)
+%Computes new aggregated network from the upper triangle J of a symmetric
+%matrix (the diagonal is only stored once)
+PP = sparse(1:length(S),S,1);
+M = PP'*J*PP;
+M = M + M' - diag(PP'*diag(J));
+end
+
+%-----%
+function Mi = permuted_column(J,p,i)
+%ith column of the reordered matrix for function handle J
+Mi=J(p(i));
+Mi=Mi(p,:);
+end
+
+%-----%
+function S = unpermute(S,p)
+%return partition of reordered network in the original node order
+if ~isempty(p)
+    S(p)=S;
+end
+end
+
+%-----%
+function p = block_randperm(n,bs)
+%random permutation that visits blocks of bs consecutive indices in random
+%order (and indices within each block in random order)
+b=randperm(ceil(n/bs));
+[~,p]=sort(b(ceil((1:n)/bs))+rand(1,n));
+end
+
+%-----%
+function Mi = metanetwork_i(J,i,mr,bs)
 %ith column of metanetwork (used to create function handle)
-%J is a function handle
-ind=metanetwork_reduce('nodes',i);
-for j=ind(:)'
-    metanetwork_reduce('reduce',J(j));
+%J is a function handle, mr the metanetwork_reduce instance
+%with block size bs, i can be a vector and the columns of J are requested in
+%blocks of bs columns
+if nargin<4||isempty(bs)
+    ind=metanetwork_reduce('nodes',mr,i);
+    for j=ind(:)'
+        metanetwork_reduce('reduce',mr,J(j));
+    end
+    Mi=metanetwork_reduce('return',mr);
+else
+    [ind,pos]=metanetwork_reduce('nodes',mr,i);
+    Mi=[];
+    for b=1:bs:numel(ind)
+        k=b:min(b+bs-1,numel(ind));
+        Mb=metanetwork_reduce('reduceblock',mr,J(ind(k)),pos(k),numel(i));
+        if isempty(Mi)
+            Mi=Mb;
+        else
+            Mi=Mi+Mb;
+        end
+    end
+end
+end
+
+%-----%
+function J = coarse_matrix(B,t,mr,bs,memory)
+%aggregated network with t nodes for function handle B (metanetwork_reduce
+%instance mr assigned to the partition) as a sparse or full matrix, whichever
+%needs less memory, or [] if neither fits into memory bytes (the function
+%handle is used instead). The sparse matrix is collected column by column in
+%metanetwork_reduce, its final size is extrapolated from the density of the
+%first columns and the build is abandoned as soon as it exceeds memory.
+if isempty(bs)
+    step=1;
+else
+    step=bs;
+end
+dense_bytes=8*t^2;
+nsample=min(t,max(64,step));
+c=1;
+bytes=0;
+while c<=t
+    idx=c:min(c+step-1,t);
+    if isempty(bs)
+        bytes=metanetwork_reduce('collect',mr,metanetwork_i(B,idx,mr));
+    else
+        bytes=metanetwork_reduce('collect',mr,metanetwork_i(B,idx,mr,bs));
+    end
+    c=idx(end)+1;
+    if c>nsample&&c-numel(idx)<=nsample
+        %estimate the size of the sparse matrix from the sample
+        sparse_bytes=bytes/(c-1)*t;
+        if min(sparse_bytes,dense_bytes)>memory
+            metanetwork_reduce('matrix',mr); %discard collected columns
+            J=[];
+            return
+        end
+        if dense_bytes<=sparse_bytes
+            %dense network, fill the remaining columns of a full matrix
+            J=zeros(t);
+            J(:,1:c-1)=full(metanetwork_reduce('matrix',mr));
+            for c=c:step:t
+                idx=c:min(c+step-1,t);
+                if isempty(bs)
+                    J(:,idx)=metanetwork_i(B,idx,mr);
+                else
+                    J(:,idx)=metanetwork_i(B,idx,mr,bs);
+                end
+            end
+            return
+        end
+    end
+    if bytes>memory
+        metanetwork_reduce('matrix',mr);
+        J=[];
+        return
+    end
+end
+J=metanetwork_reduce('matrix',mr);
+if 8*t^2<=min(bytes,memory)
+    J=full(J);
+end
+end
+
+%-----%
+function [S,Q,info] = directed_louvain(D,S0,gh,movefunction,myord,mydisp,opts)
+%Louvain passes for the directed modularity matrix
+%B(i,j)=A(i,j)-sum_t w(t)*(kout(t,i)*kin(t,j)+kin(t,i)*kout(t,j)) given by the
+%symmetrised adjacency matrix D.A, the degrees D.kin and D.kout of each node
+%in its layer D.layer and the layer weights D.weight. Bipartite networks give
+%the row- and column-class degrees D.krow and D.kcol instead (D.A may be the
+%biadjacency matrix of a single layer, with one degree per node of each class,
+%which is then embedded as [0 A;A' 0]). The degrees of an
+%aggregated node are the sums over its members, so that no column of B is
+%ever formed.
+defaults=parse_options();
+for f={'storage','reorder','coupled','layerblock','components','fold','gainsums','columnblock','cachebytes','memory','tiny','propagate','checkpoint','resume'}
+    if ~isequal(opts.(f{1}),defaults.(f{1}))
+        error('''%s'' is not supported for directed input',f{1});
+    end
+end
+if isfield(D,'krow')
+    %bipartite network: the null model only couples the row-class degree of
+    %one node with the column-class degree of the other, i.e. the degree
+    %sums kin=krow and kout=kcol with each node in a single class
+    [kin,kout,A]=deal(D.krow(:),D.kcol(:),sparse(D.A));
+    if numel(kin)+numel(kout)==numel(D.layer)
+        %biadjacency matrix (square if both classes have the same size)
+        [m,n]=size(A);
+        if m~=numel(kin)||n~=numel(kout)
+            error('biadjacency matrix does not match the degrees of the node classes');
+        end
+        A=[sparse(m,m),A;A',sparse(n,n)];
+        kin=[kin;zeros(n,1)];
+        kout=[zeros(m,1);kout];
+    end
+else
+    [kin,kout,A]=deal(D.kin(:),D.kout(:),sparse(D.A));
+end
+n=length(A);
+T=numel(D.weight);
+Rt=sparse(D.layer(:)',1:n,kin',T,n);
+Ct=sparse(D.layer(:)',1:n,kout',T,n);
+w=D.weight(:);
+if isempty(S0)
+    y=(1:n)';
+elseif numel(S0)==n
+    group_handler('assign',gh,S0);
+    y=group_handler('return',gh);
+else
+    error('Initial partition does not have the right size for the modularity matrix');
+end
+group_handler('budget',gh,opts.maxtime,opts.maxpasses);
+
+S=(1:n)';
+dtot=eps;
+truncated=false;
+if opts.hierarchy
+    hierarchy=struct('parent',{},'Q',{});
+    Qstart=directed_quality(A,Rt,Ct,w,y);
+else
+    hierarchy=[];
+end
+while true
+    mydisp(['Merging ',num2str(max(y)),' communities  ',datestr(clock)]);
+    yb=[];
+    dstep=1;
+    while (~isequal(yb,y)) && (dstep/dtot>2*eps) && (dstep>10*eps) && ~truncated
+        yb=y;
+        group_handler('assign',gh,y);
+        dstep=group_handler('movedirected',gh,movefunction,myord(n),A,Rt,Ct,w);
+        dtot=dtot+dstep;
+        y=group_handler('return',gh);
+        truncated=group_handler('truncated',gh);
+        mydisp([num2str(max(y)),' change: ',num2str(dstep),...
+            ' total: ',num2str(dtot),' relative: ',num2str(dstep/dtot)]);
+    end
+    S=y(S);
+    if opts.hierarchy
+        hierarchy=record_level(hierarchy,S,y,Qstart+2*(dtot-eps));
+    end
+    converged=max(y)==n;
+    if converged||truncated
+        Q=directed_quality(A,Rt,Ct,w,y);
+        info=run_info(truncated,hierarchy,converged,Q,[]);
+        return
+    end
+
+    %aggregate adjacency matrix and degrees
+    P=sparse(1:n,y,1);
+    A=P'*A*P;
+    Rt=Rt*P;
+    Ct=Ct*P;
+    n=length(A);
+    y=(1:n)';
+end
+end
+
+%-----%
+function [S,Q,info] = aspect_louvain(D,S0,gh,movefunction,myord,mydisp,opts,run)
+%first level for the multiaspect modularity matrix D.B+C, where the
+%interlayer coupling C (aspects of sizes D.aspects with coupling types D.type
+%and strengths D.omega) is generated by the engine. The aggregated network
+%is a sparse matrix of the size of the first-level partition, the remaining
+%levels are run by run(M,time,passes) (genlouvain with the same options).
+defaults=parse_options();
+for f={'coupled','layerblock','checkpoint','resume'}
+    if ~isequal(opts.(f{1}),defaults.(f{1}))
+        error('''%s'' is not supported for multiaspect input',f{1});
+    end
+end
+if ~any(strcmp(opts.storage,{'full','upper'}))
+    error('multiaspect input needs storage ''full'' or ''upper''');
+end
+n=length(D.B);
+aspect={D.N,D.aspects,D.type,D.omega};
+if isempty(S0)
+    y=(1:n)';
+elseif numel(S0)==n
+    group_handler('assign',gh,S0);
+    y=group_handler('return',gh);
+else
+    error('Initial partition does not have the right size for the modularity matrix');
+end
+group_handler('budget',gh,opts.maxtime,opts.maxpasses);
+start=tic;
+
+mydisp(['Merging ',num2str(max(y)),' communities  ',datestr(clock)]);
+yb=[];
+dtot=eps;
+dstep=1;
+passes=0;
+truncated=false;
+while (~isequal(yb,y)) && (dstep/dtot>2*eps) && (dstep>10*eps) && ~truncated
+    yb=y;
+    group_handler('assign',gh,y);
+    dstep=group_handler('moveaspects',gh,movefunction,myord(n),D.B,aspect{:},opts.storage);
+    dtot=dtot+dstep;
+    passes=passes+1;
+    y=group_handler('return',gh);
+    truncated=group_handler('truncated',gh);
+    mydisp([num2str(max(y)),' change: ',num2str(dstep),...
+        ' total: ',num2str(dtot),' relative: ',num2str(dstep/dtot)]);
+end
+
+M=group_handler('aspectnetwork',D.B,aspect{:},y,opts.storage);
+Q=full(trace(M));
+if opts.hierarchy
+    hierarchy=struct('parent',y,'Q',Q);
+else
+    hierarchy=[];
+end
+if truncated||max(y)==n
+    S=y;
+    info=run_info(truncated,hierarchy,max(y)==n,Q,[]);
+    return
+end
+
+if strcmp(opts.storage,'upper')
+    M=triu(M);
+end
+[S,Q,info]=run(M,max(opts.maxtime-toc(start),0),max(opts.maxpasses-passes,0));
+S=S(y);
+if opts.hierarchy
+    %the remaining levels start from the nodes of the aggregated network
+    if numel(info.hierarchy)==1&&isequal(info.hierarchy(1).parent(:),(1:length(M))')
+        hierarchy.Q=info.hierarchy.Q;
+        info.hierarchy=hierarchy;
+    else
+        info.hierarchy=[hierarchy,info.hierarchy];
+    end
+end
+end
+
+%-----%
+function Q = directed_quality(A,Rt,Ct,w,y)
+%quality of partition y for the directed modularity matrix of directed_louvain
+P=sparse(1:length(y),y,1);
+Q=full(trace(P'*A*P)-2*w'*sum((Rt*P).*(Ct*P),2));
+end
+
+%-----%
+function hierarchy = record_level(hierarchy,S,y,Q)
+%append a level to the hierarchy (if recorded), the parent array of the first
+%level is the partition S of the original nodes, later levels use the
+%partition y of the nodes of the level
+if isstruct(hierarchy)
+    if isempty(hierarchy)
+        parent=S;
+    else
+        parent=y;
+    end
+    hierarchy(end+1)=struct('parent',parent(:),'Q',Q);
+end
+end
+
+%-----%
+function info = run_info(truncated,hierarchy,converged,Q,perm)
+%output struct info, the last level is dropped from the hierarchy if it did
+%not merge any communities
+info=struct('truncated',truncated);
+if isstruct(hierarchy)
+    if converged&&numel(hierarchy)>1
+        hierarchy(end)=[];
+    end
+    hierarchy(end).Q=Q;
+    hierarchy(1).parent=unpermute(hierarchy(1).parent,perm);
+    info.hierarchy=hierarchy;
+end
+end
+
+%-----%
+function save_checkpoint(gh,file,state)
+%write checkpoint if requested
+if ~isempty(file)
+    group_handler('save',gh,file,state);
+end
+end
+
+%-----%
+function opts = parse_options(varargin)
+%Parse optional name-value pairs (names are case-insensitive)
+opts=struct('storage','full','reorder','none','layers',[],'coupled','none','layerblock',[],'threads',0,'components',false,'fold','none','hierarchy',false,'gainsums',false,'columnblock',[],'cachebytes',0,'memory',inf,'tiny',0,'propagate',0,'randblock',256,...
+    'checkpoint','','resume','','maxtime',inf,'maxpasses',inf);
+if mod(numel(varargin),2)
+    error('optional arguments need to be given as name-value pairs');
+end
+for i=1:2:numel(varargin)
+    if ~ischar(varargin{i})||~isfield(opts,lower(varargin{i}))
+        error('unknown option ''%s''',num2str(varargin{i}));
+    end
+    opts.(lower(varargin{i}))=varargin{i+1};
 end
-Mi=metanetwork_reduce('return');
 end
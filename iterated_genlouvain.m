@@ -1,4 +1,4 @@
-function [S,Q,n_it]=iterated_genlouvain(B,limit,verbose,randord,randmove,S0,postprocessor)
+function [S,Q,n_it]=iterated_genlouvain(B,limit,verbose,randord,randmove,S0,postprocessor,varargin)
 % Optimise modularity-like quality function by iterating GenLouvain until convergence.
 % (i.e., until output partition does not change between two successive iterations)
 %
@@ -78,6 +78,17 @@ function [S,Q,n_it]=iterated_genlouvain(B,limit,verbose,randord,randmove,S0,post
 %   "postprocess-categorical-multilayer.m" in HelperFunctions for a multilayer
 %   setting)
 %
+%   [S,Q,n_it] = ITERATED_GENLOUVAIN(B,limit,verbose,randord,randmove,S0,
+%   postprocessor,'Name',Value,...) passes additional name-value options
+%   to GENLOUVAIN at each iteration (see doc('genlouvain') for available
+%   options). With the 'checkpoint' option, each call of GENLOUVAIN writes
+%   checkpoints to the same file. The 'resume' option only applies to the
+%   first call of GENLOUVAIN (pass the output partition of an interrupted
+%   run as S0 instead to restart the iteration from a finished call).
+%   The 'maxtime' and 'maxpasses' budgets apply to each call of GENLOUVAIN
+%   separately and the iteration stops after the first call that exhausts
+%   its budget.
+%
 %   Example on multilayer network quality function of Mucha et al. 2010
 %   (using multilayer cell A with A{s} the adjacency matrix of layer s)
 %
@@ -212,12 +223,16 @@ end
 S_old=[];
 n_it=1;
 mydisp('Iteration 1');
-[S,Q]=genlouvain(B,limit,verbose,randord,randmove,S0);
+[S,Q,info]=genlouvain(B,limit,verbose,randord,randmove,S0,varargin{:});
+
+% only resume the first call
+resume=find(strcmpi(varargin(1:2:end),'resume'));
+varargin([2*resume-1,2*resume])=[];
 
 mydisp('');
 
 Q_old=-inf;
-while ~isequal(S,S_old)&&(Q-Q_old)>10*eps
+while ~isequal(S,S_old)&&(Q-Q_old)>10*eps&&~info.truncated
     n_it=n_it+1;
     S_old=S;
     Q_old=Q;
@@ -226,7 +241,7 @@ while ~isequal(S,S_old)&&(Q-Q_old)>10*eps
     if ~isempty(postprocessor)
         S=postprocessor(S);
     end
-    [S,Q]=genlouvain(B,limit,verbose,randord,randmove,S);
+    [S,Q,info]=genlouvain(B,limit,verbose,randord,randmove,S,varargin{:});
     mydisp(sprintf('Improvement in modularity: %f\n',Q-Q_old));
 end
 
@@ -0,0 +1,60 @@
+function Q = partition_quality(B,S,omega,coupling)
+%PARTITION_QUALITY  Value of the quality function for a set of partitions.
+%
+%   Q = PARTITION_QUALITY(B,S) with matrix B computes the quality function
+%   Q(S) = sum_ij B(i,j) delta(S(i),S(j)) encoded by the modularity/quality
+%   matrix B for each partition in S. S is either a single partition, a
+%   matrix with one partition per column or a cell of partitions. The
+%   output Q is a vector with Q(k) the quality of the kth partition
+%   (without any rescaling, i.e., as returned by GENLOUVAIN).
+%
+%   Q = PARTITION_QUALITY(B,S) with function handle B such that B(i) returns
+%   the ith column of the modularity/quality matrix requests each column
+%   exactly once, independent of the number of partitions. This is useful
+%   to score an ensemble of partitions obtained from repeated runs of
+%   GENLOUVAIN.
+%
+%   Q = PARTITION_QUALITY(A,S,omega,coupling) with cell A of intralayer
+%   modularity matrices (A{s} the N x N modularity matrix of layer s)
+%   computes the multilayer quality function with uniform interlayer
+%   coupling of strength omega. The coupling type is either 'ordinal' (see
+%   multiord) or 'categorical' (see multicat). Each partition in S is an
+%   N x T multilayer partition (or a vector of length N*T) and the
+%   interlayer contribution is computed directly from the partitions
+%   without building the coupling matrix.
+%
+%   Example (ensemble of partitions for the same modularity matrix B)
+%         S = zeros(length(B),100);
+%         for k=1:100
+%             S(:,k) = genlouvain(B,[],0);
+%         end
+%         Q = partition_quality(B,S);
+%
+%   See also genlouvain iterated_genlouvain HelperFunctions
+
+if iscell(S)
+    S=cellfun(@(s) s(:), S, 'UniformOutput', false);
+    S=[S{:}];
+end
+
+if iscell(B)
+    if nargin<4||isempty(coupling)
+        coupling='ordinal';
+    end
+    if nargin<3||isempty(omega)
+        omega=1;
+    end
+    T=numel(B);
+    S=reshape(S,length(B{1})*T,[]);
+    Q=group_handler('quality',B,double(S),omega,coupling);
+else
+    if isa(B,'function_handle')
+        n=length(B(1));
+    else
+        n=length(B);
+    end
+    S=reshape(S,n,[]);
+    Q=group_handler('quality',B,double(S));
+end
+
+end